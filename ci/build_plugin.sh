@@ -5,6 +5,7 @@ apt-get update
 apt-get install --no-install-recommends --no-install-suggests -y \
                 build-essential \
                 cmake \
+                zlib1g-dev \
                 wget \
                 git \
                 ca-certificates
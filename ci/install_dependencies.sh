@@ -4,6 +4,7 @@ set -e
 apt-get update
 apt-get install --no-install-recommends --no-install-suggests -y \
                 libcurl4-openssl-dev \
+                zlib1g-dev \
                 build-essential \
                 cmake \
                 git \
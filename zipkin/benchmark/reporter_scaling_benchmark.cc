@@ -0,0 +1,135 @@
+#include "../src/zipkin_reporter_impl.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace zipkin;
+
+static const int SPANS_PER_THREAD = 200000;
+
+namespace {
+// Discards spans, so that the benchmark measures the cost of reporting them.
+class NullTransporter : public Transporter {
+public:
+  void transportSpans(SpanBuffer &spans) override {}
+};
+
+// Reports spans the way ReporterImpl did before it used a SpanQueue: every
+// span is added to a single buffer under a single mutex, which the writer
+// swaps out.
+class MutexReporter : public Reporter {
+public:
+  explicit MutexReporter(size_t max_buffered_spans)
+      : max_buffered_spans_{max_buffered_spans}, spans_{max_buffered_spans},
+        inflight_spans_{max_buffered_spans} {
+    writer_ = std::thread(&MutexReporter::writeReports, this);
+  }
+
+  ~MutexReporter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+    }
+    cond_.notify_all();
+    writer_.join();
+  }
+
+  void reportSpan(const Span &span) override { reportSpan(Span{span}); }
+
+  void reportSpan(Span &&span) override {
+    bool is_full;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      spans_.addSpan(std::move(span));
+      is_full = spans_.pendingSpans() == max_buffered_spans_;
+    }
+    if (is_full)
+      cond_.notify_one();
+  }
+
+private:
+  size_t max_buffered_spans_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool exit_ = false;
+  SpanBuffer spans_;
+  SpanBuffer inflight_spans_;
+  std::thread writer_;
+
+  void writeReports() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (!exit_) {
+      cond_.wait_for(lock, DEFAULT_REPORTING_PERIOD);
+      inflight_spans_.swap(spans_);
+      lock.unlock();
+      inflight_spans_.clear();
+      lock.lock();
+    }
+  }
+};
+} // namespace
+
+static Span makeSpan() {
+  Endpoint endpoint{"frontend", IpAddress{IpVersion::v4, "10.0.0.1", 8080}};
+  Span span;
+  span.setName("GET /api/v1/users");
+  span.setTimestamp(1500000000000000);
+  span.setDuration(1234);
+  span.addAnnotation(Annotation{1500000000000000, "sr", endpoint});
+  span.addAnnotation(Annotation{1500000000001234, "ss", endpoint});
+  span.addBinaryAnnotation(BinaryAnnotation{"http.method", "GET"});
+  return span;
+}
+
+// Reports spans from the given number of threads and returns the number of
+// spans reported per second, across all threads.
+static double measure(Reporter &reporter, int num_threads) {
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&reporter] {
+      for (int j = 0; j < SPANS_PER_THREAD; ++j) {
+        Span span = makeSpan();
+        span.setId(j);
+        reporter.reportSpan(std::move(span));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return num_threads * SPANS_PER_THREAD / elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  int max_threads = argc > 1
+                        ? std::atoi(argv[1])
+                        : static_cast<int>(std::thread::hardware_concurrency());
+  if (max_threads < 1) {
+    max_threads = 1;
+  }
+
+  std::cout << SPANS_PER_THREAD << " spans per thread\n";
+  std::cout << std::setw(8) << "threads" << std::setw(20) << "mutex spans/s"
+            << std::setw(20) << "queue spans/s" << '\n';
+  for (int num_threads = 1;; num_threads *= 2) {
+    num_threads = std::min(num_threads, max_threads);
+    MutexReporter mutex_reporter{DEFAULT_SPAN_BUFFER_SIZE};
+    ReporterImpl queue_reporter{TransporterPtr{new NullTransporter{}}};
+    auto mutex_rate = measure(mutex_reporter, num_threads);
+    auto queue_rate = measure(queue_reporter, num_threads);
+    std::cout << std::setw(8) << num_threads << std::fixed
+              << std::setprecision(0) << std::setw(20) << mutex_rate
+              << std::setw(20) << queue_rate << '\n';
+    if (num_threads == max_threads) {
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+#include "../src/json_v1_encoder.h"
+#include "../src/span_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// Counts the heap allocations made by the process, so that the allocations
+// made by each serialization strategy can be measured. rapidjson allocates
+// with malloc() and realloc() rather than operator new, so those are wrapped
+// as well. This relies on glibc exposing its allocator as __libc_malloc().
+static std::atomic<uint64_t> allocation_count{0};
+static std::atomic<uint64_t> allocated_bytes{0};
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+  ++allocation_count;
+  allocated_bytes += size;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  ++allocation_count;
+  allocated_bytes += count * size;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  ++allocation_count;
+  allocated_bytes += size;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) { __libc_free(ptr); }
+}
+
+using namespace zipkin;
+
+static const size_t NUM_SPANS = 1000;
+static const int NUM_FLUSHES = 200;
+
+static Span makeSpan(uint64_t id) {
+  Endpoint endpoint{"frontend", IpAddress{IpVersion::v4, "10.0.0.1", 8080}};
+  Span span;
+  span.setTraceId(TraceId{0, id});
+  span.setId(id);
+  span.setParentId(id + 1);
+  span.setName("GET /api/v1/users");
+  span.setTimestamp(1500000000000000);
+  span.setDuration(1234);
+  span.addAnnotation(Annotation{1500000000000000, "sr", endpoint});
+  span.addAnnotation(Annotation{1500000000001234, "ss", endpoint});
+  BinaryAnnotation method{"http.method", "GET"};
+  method.setEndpoint(endpoint);
+  span.addBinaryAnnotation(std::move(method));
+  BinaryAnnotation url{"http.url", "http://example.com/api/v1/users?page=2"};
+  url.setEndpoint(endpoint);
+  span.addBinaryAnnotation(std::move(url));
+  BinaryAnnotation status;
+  status.setKey("http.status_code");
+  status.setValue(static_cast<int64_t>(200));
+  status.setEndpoint(endpoint);
+  span.addBinaryAnnotation(std::move(status));
+  return span;
+}
+
+// Serializes each span with Span::toJson() and concatenates the results, the
+// way SpanBuffer::toStringifiedJsonArray() used to.
+static size_t concatenateSpans(std::vector<Span> &spans) {
+  std::string result = "[";
+  for (auto &span : spans) {
+    if (result.size() > 1) {
+      result += ",";
+    }
+    result += span.toJson();
+  }
+  result += "]";
+  return result.size();
+}
+
+// Encodes the batch into a new buffer, with a new encoder.
+static size_t encodeIntoFreshBuffer(const SpanBuffer &spans) {
+  rapidjson::StringBuffer buffer;
+  JsonV1Encoder encoder;
+  spans.encode(encoder, buffer);
+  return buffer.GetSize();
+}
+
+// Encodes the batch into a buffer and encoder kept across flushes, the way
+// ZipkinHttpTransporter does.
+static size_t encodeIntoReusedBuffer(const SpanBuffer &spans,
+                                     rapidjson::StringBuffer &buffer,
+                                     JsonV1Encoder &encoder) {
+  buffer.Clear();
+  buffer.Reserve(spans.encodedSizeEstimate() + 1);
+  spans.encode(encoder, buffer);
+  return buffer.GetSize();
+}
+
+template <class F> static void run(const char *name, F flush) {
+  // Warm up, so that buffers kept across flushes reach their steady size.
+  size_t size = flush();
+  uint64_t count_before = allocation_count;
+  uint64_t bytes_before = allocated_bytes;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_FLUSHES; ++i) {
+    size += flush();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  auto micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  std::cout << std::left << std::setw(24) << name << std::right
+            << std::setw(14) << (allocation_count - count_before) / NUM_FLUSHES
+            << std::setw(16) << (allocated_bytes - bytes_before) / NUM_FLUSHES
+            << std::setw(14) << micros / NUM_FLUSHES << '\n';
+  if (size == 0) {
+    std::cerr << "nothing was serialized\n";
+  }
+}
+
+int main() {
+  SpanBuffer spans{NUM_SPANS};
+  std::vector<Span> span_vector;
+  for (size_t i = 0; i < NUM_SPANS; ++i) {
+    spans.addSpan(makeSpan(i + 1));
+    span_vector.push_back(makeSpan(i + 1));
+  }
+
+  std::cout << NUM_SPANS << " spans per flush\n";
+  std::cout << std::left << std::setw(24) << "strategy" << std::right
+            << std::setw(14) << "allocs/flush" << std::setw(16)
+            << "bytes/flush" << std::setw(14) << "us/flush" << '\n';
+
+  run("concatenated toJson()", [&] { return concatenateSpans(span_vector); });
+  run("fresh buffer", [&] { return encodeIntoFreshBuffer(spans); });
+
+  rapidjson::StringBuffer buffer;
+  JsonV1Encoder encoder;
+  run("reused, pre-sized", [&] {
+    return encodeIntoReusedBuffer(spans, buffer, encoder);
+  });
+
+  std::cout << "estimated " << spans.encodedSizeEstimate() << " bytes, encoded "
+            << buffer.GetSize() << " bytes\n";
+  return 0;
+}
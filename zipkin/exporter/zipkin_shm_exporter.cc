@@ -0,0 +1,120 @@
+// Sends the spans that the processes of a multi-process server hand over
+// through shared memory (see zipkin::makeSharedMemoryReporter) on to a Zipkin
+// collector, over a single set of connections.
+#include "../src/shm_span_ring.h"
+#include "../src/zipkin_http_transporter.h"
+
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace zipkin;
+
+static volatile std::sig_atomic_t exit_requested = 0;
+
+static void requestExit(int) { exit_requested = 1; }
+
+static void printUsage(const char *program) {
+  std::cerr
+      << "Usage: " << program << " [options]\n"
+      << "  --name NAME               shared memory ring (default "
+         "/zipkin-spans)\n"
+      << "  --ring-size BYTES         size of the ring if it is created\n"
+      << "  --encoding ENCODING       json_v1, json_v2 or proto3\n"
+      << "  --collector-host HOST     collector host (default localhost)\n"
+      << "  --collector-port PORT     collector port (default 9411)\n"
+      << "  --collector-timeout MS    timeout for each request\n"
+      << "  --compression-level LEVEL gzip level from 1 to 9, or 0\n"
+      << "  --max-inflight-requests N batches in flight at once\n"
+      << "  --poll-interval MS        time between reads of the ring\n";
+}
+
+static bool parseEncoding(const std::string &value, SpanEncoding &encoding) {
+  if (value == "json_v1") {
+    encoding = SpanEncoding::JSON_V1;
+  } else if (value == "json_v2") {
+    encoding = SpanEncoding::JSON_V2;
+  } else if (value == "proto3") {
+    encoding = SpanEncoding::PROTO3;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  SharedMemoryTransportOptions ring_options;
+  HttpTransportOptions http_options;
+  std::chrono::milliseconds poll_interval{100};
+  // Numeric values are parsed with std::stoul() and friends, which throw if a
+  // value isn't a number or is out of range.
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string option = argv[i];
+      if (i + 1 == argc) {
+        printUsage(argv[0]);
+        return 1;
+      }
+      std::string value = argv[++i];
+      if (option == "--name") {
+        ring_options.name = value;
+      } else if (option == "--ring-size") {
+        ring_options.ring_size = std::stoul(value);
+      } else if (option == "--encoding") {
+        if (!parseEncoding(value, ring_options.encoding)) {
+          printUsage(argv[0]);
+          return 1;
+        }
+      } else if (option == "--collector-host") {
+        http_options.collector_host = value;
+      } else if (option == "--collector-port") {
+        http_options.collector_port = std::stoul(value);
+      } else if (option == "--collector-timeout") {
+        http_options.collector_timeout =
+            std::chrono::milliseconds{std::stol(value)};
+      } else if (option == "--compression-level") {
+        http_options.compression_level = std::stoi(value);
+      } else if (option == "--max-inflight-requests") {
+        http_options.max_inflight_requests = std::stoul(value);
+      } else if (option == "--poll-interval") {
+        poll_interval = std::chrono::milliseconds{std::stol(value)};
+      } else {
+        printUsage(argv[0]);
+        return 1;
+      }
+    }
+  } catch (const std::logic_error &) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  http_options.encoding = ring_options.encoding;
+
+  std::signal(SIGINT, requestExit);
+  std::signal(SIGTERM, requestExit);
+  try {
+    ShmSpanRing ring{ring_options.name, ring_options.ring_size,
+                     ring_options.encoding};
+    ZipkinHttpTransporter transporter{http_options};
+    std::string record;
+    uint32_t num_spans;
+    while (true) {
+      auto exiting = exit_requested != 0;
+      while (ring.read(record, num_spans)) {
+        transporter.transportEncodedSpans(record.data(), record.size(),
+                                          num_spans);
+      }
+      if (exiting) {
+        break;
+      }
+      std::this_thread::sleep_for(poll_interval);
+    }
+    transporter.flush(SteadyClock::now() + DEFAULT_DRAIN_TIMEOUT);
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -42,12 +42,28 @@ public:
    */
   static std::string uint64ToHex(uint64_t value);
 
+  /**
+   * Writes the 16 hexadecimal digits of the given 64-bit integer without
+   * allocating.
+   * @param value The integer to be converted.
+   * @param out The destination; must have room for 16 characters.
+   */
+  static void uint64ToHex(uint64_t value, char *out);
+
   /**
    * Converts the given TraceId into a hexadecimal string.
    * @param trace_id The TraceId to be converted.
    */
   static std::string traceIdToHex(const TraceId &value);
 
+  /**
+   * Writes the hexadecimal digits of the given TraceId without allocating.
+   * @param trace_id The TraceId to be converted.
+   * @param out The destination; must have room for 32 characters.
+   * @return the number of characters written (16 or 32).
+   */
+  static size_t traceIdToHex(const TraceId &value, char *out);
+
   /**
    * Converts the given hexadecimal string into a 64-bit integer.
    * @param value The hexadecimal string to be converted.
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include <zipkin/span_context.h>
 #include <zipkin/tracer_interface.h>
 #include <zipkin/utility.h>
@@ -10,6 +12,411 @@ const SteadyClock::duration DEFAULT_REPORTING_PERIOD =
     std::chrono::milliseconds{500};
 const size_t DEFAULT_SPAN_BUFFER_SIZE = 1000;
 const std::chrono::milliseconds DEFAULT_TRANSPORT_TIMEOUT = std::chrono::milliseconds{0};
+const std::chrono::milliseconds DEFAULT_OVERFLOW_BLOCK_TIMEOUT =
+    std::chrono::milliseconds{100};
+const std::chrono::milliseconds DEFAULT_DRAIN_TIMEOUT =
+    std::chrono::milliseconds{5000};
+const size_t DEFAULT_MAX_INFLIGHT_REQUESTS = 2;
+const size_t DEFAULT_MAX_DATAGRAM_SIZE = 65000;
+const size_t DEFAULT_SHM_RING_SIZE = 16 * 1024 * 1024;
+const size_t DEFAULT_SPOOL_MAX_BYTES = 64 * 1024 * 1024;
+const int DEFAULT_MAX_RETRIES = 3;
+const std::chrono::milliseconds DEFAULT_RETRY_BASE_DELAY =
+    std::chrono::milliseconds{100};
+const std::chrono::milliseconds DEFAULT_COLLECTOR_EJECTION_TIME =
+    std::chrono::milliseconds{30000};
+const std::chrono::milliseconds DEFAULT_TAIL_SAMPLING_DECISION_WAIT =
+    std::chrono::milliseconds{5000};
+const size_t DEFAULT_TAIL_SAMPLING_MAX_BUFFERED_BYTES = 32 * 1024 * 1024;
+
+/**
+ * Wire formats that spans can be sent to a Zipkin collector in.
+ *
+ * JSON_V1 is the original format posted to /api/v1/spans. JSON_V2 is posted to
+ * /api/v2/spans; it records a single local endpoint per span instead of
+ * repeating it in every annotation, and is roughly half the size. PROTO3 posts
+ * the same model as a zipkin.proto3.ListOfSpans protobuf to /api/v2/spans.
+ */
+enum class SpanEncoding { JSON_V1, JSON_V2, PROTO3 };
+
+/**
+ * How batches are spread across several collectors.
+ *
+ * ROUND_ROBIN sends each batch to the next collector in turn.
+ * LEAST_OUTSTANDING sends it to the collector with the fewest requests in
+ * flight. TRACE_ID_HASH splits each batch by a hash of the trace ID, so that
+ * all the spans of a trace are sent to the same collector.
+ */
+enum class LoadBalancingPolicy {
+  ROUND_ROBIN,
+  LEAST_OUTSTANDING,
+  TRACE_ID_HASH
+};
+
+/**
+ * What a Reporter does with a finished span when its buffer is full.
+ *
+ * DROP_NEWEST discards the finished span. DROP_OLDEST discards the oldest
+ * buffered span to make room for it. BLOCK makes the reporting thread wait
+ * for the buffer to be flushed, for up to a bounded time, before discarding
+ * the span.
+ */
+enum class OverflowPolicy { DROP_NEWEST, DROP_OLDEST, BLOCK };
+
+struct ReporterStats;
+
+/**
+ * Options that control how a Reporter buffers spans.
+ */
+struct ReporterOptions {
+  /**
+   * The time between sending successive batches of spans.
+   */
+  SteadyClock::duration reporting_period = DEFAULT_REPORTING_PERIOD;
+
+  /**
+   * The maximum number of spans to buffer.
+   */
+  size_t max_buffered_spans = DEFAULT_SPAN_BUFFER_SIZE;
+
+  /**
+   * The approximate maximum memory, in bytes, used by buffered spans. Spans of
+   * very different sizes are better bounded by memory than by count. If zero,
+   * only max_buffered_spans applies.
+   */
+  size_t max_buffered_bytes = 0;
+
+  /**
+   * What to do with finished spans when the buffer is full.
+   */
+  OverflowPolicy overflow_policy = OverflowPolicy::DROP_NEWEST;
+
+  /**
+   * The longest a reporting thread waits for room in the buffer when the
+   * overflow policy is BLOCK.
+   */
+  std::chrono::milliseconds overflow_block_timeout =
+      DEFAULT_OVERFLOW_BLOCK_TIMEOUT;
+
+  /**
+   * The longest the reporter spends sending the spans still buffered when it
+   * is destroyed. Spans left after that are abandoned.
+   */
+  std::chrono::milliseconds drain_timeout = DEFAULT_DRAIN_TIMEOUT;
+
+  /**
+   * Called, if set, once the reporter has finished draining when it is
+   * destroyed, with its final counters, including spans_drained and
+   * spans_abandoned.
+   */
+  std::function<void(const ReporterStats &stats)> drain_callback;
+};
+
+/**
+ * Options that control how spans are sent to a Zipkin collector over HTTP.
+ */
+struct HttpTransportOptions {
+  /**
+   * The host of the Zipkin collector.
+   */
+  std::string collector_host = "localhost";
+
+  /**
+   * The port of the Zipkin collector.
+   */
+  uint32_t collector_port = 9411;
+
+  /**
+   * The timeout for each request. Zero means no timeout.
+   */
+  std::chrono::milliseconds collector_timeout = DEFAULT_TRANSPORT_TIMEOUT;
+
+  /**
+   * The format to send spans in.
+   */
+  SpanEncoding encoding = SpanEncoding::JSON_V1;
+
+  /**
+   * The number of batches that can be in flight to the collector at once.
+   * While they are, further batches are encoded and sent without waiting for
+   * earlier ones to complete.
+   */
+  size_t max_inflight_requests = DEFAULT_MAX_INFLIGHT_REQUESTS;
+
+  /**
+   * If true, request bodies are sent with chunked transfer encoding, and spans
+   * are encoded as libcurl asks for more of the body. A batch is then never
+   * held in memory in encoded form, only a chunk of it at a time.
+   */
+  bool stream_request_body = false;
+
+  /**
+   * If between 1 (fastest) and 9 (smallest), request bodies are compressed
+   * with gzip at that zlib compression level and sent with
+   * "Content-Encoding: gzip". Zero sends them uncompressed.
+   */
+  int compression_level = 0;
+
+  /**
+   * A directory to keep batches that fail to send in, to send them again once
+   * the collector can be reached. It must not be shared with other
+   * processes. Batches left by an earlier process with a different encoding
+   * or compression are discarded. If empty, batches that fail to send are
+   * dropped.
+   */
+  std::string spool_directory;
+
+  /**
+   * The most disk space, in bytes, used for spooled batches. Batches that
+   * fail to send while the spool is full are dropped.
+   */
+  size_t spool_max_bytes = DEFAULT_SPOOL_MAX_BYTES;
+
+  /**
+   * The number of times a batch is sent again after a transport error, or
+   * after a response saying the collector may accept it later (408, 429 or
+   * 5xx). Batches that still fail are spooled or dropped, as are batches
+   * rejected with any other status.
+   */
+  int max_retries = DEFAULT_MAX_RETRIES;
+
+  /**
+   * The delay before the first retry of a batch. It is doubled for each
+   * further retry, and randomized by up to half. A longer Retry-After from
+   * the collector takes precedence.
+   */
+  std::chrono::milliseconds retry_base_delay = DEFAULT_RETRY_BASE_DELAY;
+
+  /**
+   * The URLs of the collectors to send spans to, for instance
+   * "http://zipkin-1:9411". The endpoint for the encoding is appended to URLs
+   * without a path. If empty, spans are sent to collector_host and
+   * collector_port.
+   */
+  std::vector<std::string> collector_urls;
+
+  /**
+   * How batches are spread across collector_urls.
+   */
+  LoadBalancingPolicy load_balancing_policy = LoadBalancingPolicy::ROUND_ROBIN;
+
+  /**
+   * How long a collector that fails several requests in a row is avoided
+   * for. Batches are still sent to it if every collector is avoided.
+   */
+  std::chrono::milliseconds collector_ejection_time =
+      DEFAULT_COLLECTOR_EJECTION_TIME;
+};
+
+/**
+ * Options that control how spans are sent to a collector agent over a Unix
+ * domain socket.
+ */
+struct UnixSocketTransportOptions {
+  /**
+   * The path of the socket the agent listens on.
+   */
+  std::string socket_path;
+
+  /**
+   * The format to send spans in.
+   */
+  SpanEncoding encoding = SpanEncoding::JSON_V1;
+
+  /**
+   * The longest a batch waits for room in the socket's buffer when the agent
+   * is not reading fast enough. The batch is dropped after that.
+   */
+  std::chrono::milliseconds write_timeout = std::chrono::milliseconds{100};
+};
+
+/**
+ * Options that control how spans are sent to a collector as UDP datagrams.
+ */
+struct UdpTransportOptions {
+  /**
+   * The host of the collector.
+   */
+  std::string collector_host = "localhost";
+
+  /**
+   * The UDP port of the collector.
+   */
+  uint32_t collector_port = 9411;
+
+  /**
+   * The format to send spans in. Each datagram holds a complete list of spans
+   * in this format.
+   */
+  SpanEncoding encoding = SpanEncoding::JSON_V1;
+
+  /**
+   * The largest datagram to send, in bytes. 65000 fits the largest UDP
+   * payload; 1400 fits a typical Ethernet MTU, avoiding IP fragmentation.
+   * Spans too large to fit in a datagram on their own are dropped.
+   */
+  size_t max_datagram_size = DEFAULT_MAX_DATAGRAM_SIZE;
+};
+
+/**
+ * When spans written to a file are flushed to disk with fsync().
+ *
+ * NEVER leaves it to the operating system. EVERY_BATCH syncs after each batch
+ * is written. ON_ROTATE syncs a file only when it is closed to be rotated.
+ */
+enum class FsyncPolicy { NEVER, EVERY_BATCH, ON_ROTATE };
+
+/**
+ * Options that control how spans are written to a file as newline-delimited
+ * JSON.
+ */
+struct FileTransportOptions {
+  /**
+   * The path of the file to append spans to.
+   */
+  std::string path;
+
+  /**
+   * The format to write spans in. Only the JSON formats are supported.
+   */
+  SpanEncoding encoding = SpanEncoding::JSON_V1;
+
+  /**
+   * The size, in bytes, that a batch may not take the file over. The file is
+   * rotated first instead. If zero, files are not rotated by size.
+   */
+  size_t max_file_size = 0;
+
+  /**
+   * The age at which the file is rotated. If zero, files are not rotated by
+   * age.
+   */
+  std::chrono::seconds max_file_age{0};
+
+  /**
+   * The number of rotated files kept, as path.1 to path.N. If zero, the file
+   * is removed when it is rotated.
+   */
+  size_t max_rotated_files = 5;
+
+  /**
+   * When written spans are flushed to disk.
+   */
+  FsyncPolicy fsync_policy = FsyncPolicy::NEVER;
+};
+
+/**
+ * Options that control how spans are handed to an exporter process through
+ * shared memory.
+ */
+struct SharedMemoryTransportOptions {
+  /**
+   * The name of the POSIX shared memory object holding the ring of spans.
+   */
+  std::string name = "/zipkin-spans";
+
+  /**
+   * The size, in bytes, of the ring if this process creates it.
+   */
+  size_t ring_size = DEFAULT_SHM_RING_SIZE;
+
+  /**
+   * The format spans are encoded in. The exporter sends them on to the
+   * collector as they are, so this is also the format the collector gets.
+   */
+  SpanEncoding encoding = SpanEncoding::JSON_V1;
+};
+
+/**
+ * Options that control which traces a tail-sampling reporter forwards. A
+ * trace is kept if any of its spans has an "error" tag, or lasts at least the
+ * latency_threshold. Otherwise it is kept with the probability sample_rate,
+ * decided from its trace ID.
+ */
+struct TailSamplingOptions {
+  /**
+   * How long to wait for the local root span of a trace to finish, counted
+   * from the first span of the trace that finishes. Once it has passed, the
+   * decision is made on the spans received so far.
+   */
+  std::chrono::milliseconds decision_wait = DEFAULT_TAIL_SAMPLING_DECISION_WAIT;
+
+  /**
+   * Traces with a span that lasts at least this long are kept. Zero disables
+   * the rule.
+   */
+  std::chrono::microseconds latency_threshold{0};
+
+  /**
+   * The fraction of the traces not kept by the other rules that is kept.
+   */
+  double sample_rate = 0.01;
+
+  /**
+   * The memory budget for the spans held while waiting for a decision, as
+   * estimated by the reporter. When it is exceeded, the decision for the
+   * oldest traces is made early.
+   */
+  size_t max_buffered_bytes = DEFAULT_TAIL_SAMPLING_MAX_BUFFERED_BYTES;
+};
+
+/**
+ * Counters describing what a Reporter has done with the spans reported to it.
+ * Every accepted span is eventually either flushed or dropped.
+ */
+struct ReporterStats {
+  /**
+   * The number of spans added to the buffer.
+   */
+  uint64_t spans_accepted = 0;
+
+  /**
+   * The number of spans discarded because the buffer was full, or over its
+   * memory budget, including buffered spans discarded to make room under
+   * OverflowPolicy::DROP_OLDEST.
+   */
+  uint64_t spans_dropped = 0;
+
+  /**
+   * The number of spans the transport sent.
+   */
+  uint64_t spans_flushed = 0;
+
+  /**
+   * The number of spans that the transport discarded instead of sending, for
+   * instance because they were too large for it.
+   */
+  uint64_t spans_dropped_by_transport = 0;
+
+  /**
+   * The number of spans handed to the transport while the reporter drained
+   * its buffer on destruction.
+   */
+  uint64_t spans_drained = 0;
+
+  /**
+   * The number of spans the reporter gave up on when it was destroyed,
+   * because draining took longer than drain_timeout.
+   */
+  uint64_t spans_abandoned = 0;
+
+  /**
+   * The number of traces a tail-sampling reporter has forwarded.
+   */
+  uint64_t traces_kept = 0;
+
+  /**
+   * The number of traces a tail-sampling reporter has discarded.
+   */
+  uint64_t traces_discarded = 0;
+
+  /**
+   * The number of traces a tail-sampling reporter decided on before their
+   * local root span finished or their decision_wait passed, to stay within
+   * its memory budget.
+   */
+  uint64_t traces_evicted = 0;
+};
 
 /**
  * Abstract class that delegates to users of the Tracer class the responsibility
@@ -32,15 +439,37 @@ public:
    */
   virtual void reportSpan(const Span &span) = 0;
 
+  /**
+   * Handles a finished span that the caller no longer needs. Reporters that
+   * buffer spans should override this method to take ownership of the span
+   * without copying it. The default implementation forwards to
+   * reportSpan(const Span&).
+   *
+   * @param span The span that needs action.
+   */
+  virtual void reportSpan(Span &&span) {
+    reportSpan(static_cast<const Span &>(span));
+  }
+
   /**
    * Optional method that a concrete Reporter class can implement to flush
    * buffered spans.
    *
    * @param timeout The timeout to use when flushing.
+   * @return true if the spans reported so far were sent, or false if some
+   * could not be sent within the timeout.
    */
   virtual bool flushWithTimeout(std::chrono::system_clock::duration timeout) {
     return true;
   }
+
+  /**
+   * Optional method that a concrete Reporter class can implement to report
+   * how many spans it has accepted, dropped and flushed.
+   *
+   * @return the reporter's counters.
+   */
+  virtual ReporterStats stats() const { return ReporterStats{}; }
 };
 
 typedef std::unique_ptr<Reporter> ReporterPtr;
@@ -52,13 +481,108 @@ typedef std::unique_ptr<Reporter> ReporterPtr;
  * service.
  * @param collector_port The port to use when sending spans to the Zipkin
  * service.
+ * @param encoding The format to send spans in.
  * @return a Reporter object.
  */
 ReporterPtr makeHttpReporter(
     const char *collector_host, uint32_t collector_port,
     std::chrono::milliseconds collector_timeout = DEFAULT_TRANSPORT_TIMEOUT,
     SteadyClock::duration reporting_period = DEFAULT_REPORTING_PERIOD,
-    size_t max_buffered_spans = DEFAULT_SPAN_BUFFER_SIZE);
+    size_t max_buffered_spans = DEFAULT_SPAN_BUFFER_SIZE,
+    SpanEncoding encoding = SpanEncoding::JSON_V1);
+
+/**
+ * Construct a Reporter that sends spans to a Zipkin service via HTTP.
+ *
+ * @param collector_host The host to use when sending spans to the Zipkin
+ * service.
+ * @param collector_port The port to use when sending spans to the Zipkin
+ * service.
+ * @param collector_timeout The timeout to use when sending spans.
+ * @param encoding The format to send spans in.
+ * @param options The options that control how spans are buffered.
+ * @return a Reporter object.
+ */
+ReporterPtr makeHttpReporter(const char *collector_host,
+                             uint32_t collector_port,
+                             std::chrono::milliseconds collector_timeout,
+                             SpanEncoding encoding,
+                             const ReporterOptions &options);
+
+/**
+ * Construct a Reporter that sends spans to a Zipkin service via HTTP.
+ *
+ * @param transport_options The options that control how spans are sent.
+ * @param reporter_options The options that control how spans are buffered.
+ * @return a Reporter object.
+ */
+ReporterPtr makeHttpReporter(const HttpTransportOptions &transport_options,
+                             const ReporterOptions &reporter_options);
+
+/**
+ * Construct a Reporter that sends spans to a collector agent listening on a
+ * Unix domain socket. Each batch is sent as its size, a 4-byte big-endian
+ * integer, followed by the encoded spans.
+ *
+ * @param transport_options The options that control how spans are sent.
+ * @param reporter_options The options that control how spans are buffered.
+ * @return a Reporter object, or nullptr if the socket path is invalid.
+ */
+ReporterPtr
+makeUnixSocketReporter(const UnixSocketTransportOptions &transport_options,
+                       const ReporterOptions &reporter_options);
+
+/**
+ * Construct a Reporter that sends spans to a collector as UDP datagrams.
+ * Nothing is retried, and the reporting thread never waits on the network.
+ *
+ * @param transport_options The options that control how spans are sent.
+ * @param reporter_options The options that control how spans are buffered.
+ * @return a Reporter object, or nullptr if the collector's address can't be
+ * resolved.
+ */
+ReporterPtr makeUdpReporter(const UdpTransportOptions &transport_options,
+                            const ReporterOptions &reporter_options);
+
+/**
+ * Construct a Reporter that appends spans to a file, one JSON object per line,
+ * for a log shipping agent to pick up. Collector outages then never back up
+ * into the reporter's buffer.
+ *
+ * @param transport_options The options that control how spans are written.
+ * @param reporter_options The options that control how spans are buffered.
+ * @return a Reporter object, or nullptr if the options are invalid.
+ */
+ReporterPtr makeFileReporter(const FileTransportOptions &transport_options,
+                             const ReporterOptions &reporter_options);
+
+/**
+ * Construct a Reporter that hands spans to an exporter process, such as
+ * zipkin_shm_exporter, through a ring buffer in shared memory. Every process
+ * of a multi-process server can then share one connection to the collector.
+ *
+ * @param transport_options The options that control how spans are handed
+ * over.
+ * @param reporter_options The options that control how spans are buffered.
+ * @return a Reporter object, or nullptr if the ring can't be opened.
+ */
+ReporterPtr
+makeSharedMemoryReporter(const SharedMemoryTransportOptions &transport_options,
+                         const ReporterOptions &reporter_options);
+
+/**
+ * Construct a Reporter that holds finished spans grouped by trace, and
+ * forwards the traces chosen by tail sampling to another reporter. A trace is
+ * decided once its local root span, a span without a parent or a server span,
+ * finishes. Spans only reach the reporter if they were sampled when they
+ * started, so tracers using it should sample every trace.
+ *
+ * @param reporter The reporter to forward kept traces to.
+ * @param options The options that control which traces are kept.
+ * @return a Reporter object.
+ */
+ReporterPtr makeTailSamplingReporter(ReporterPtr &&reporter,
+                                     const TailSamplingOptions &options);
 
 /**
  * This class implements the Zipkin tracer. It has methods to create the
@@ -137,6 +661,15 @@ public:
     return false;
   }
 
+  /**
+   * @return the counters of the associated Reporter.
+   */
+  ReporterStats reporterStats() const {
+    if (reporter_)
+      return reporter_->stats();
+    return ReporterStats{};
+  }
+
 private:
   const std::string service_name_;
   IpAddress address_;
@@ -107,6 +107,16 @@ public:
    */
   Annotation &operator=(const Annotation &);
 
+  /**
+   * Move constructor.
+   */
+  Annotation(Annotation &&) = default;
+
+  /**
+   * Move assignment operator.
+   */
+  Annotation &operator=(Annotation &&) = default;
+
   /**
    * Default constructor. Creates an empty annotation.
    */
@@ -0,0 +1,79 @@
+#include "gzip_span_encoder.h"
+
+#include <cstring>
+#include <new>
+
+namespace zipkin {
+// The amount of uncompressed output that is collected before it is deflated.
+// Deflating larger pieces costs fewer calls into zlib but more memory.
+static const size_t SCRATCH_SIZE = 16 * 1024;
+
+// The amount the output buffer is grown by while deflating.
+static const size_t OUTPUT_CHUNK_SIZE = 4 * 1024;
+
+// Adding 16 to the window bits makes zlib write a gzip header and trailer
+// instead of a zlib one.
+static const int GZIP_WINDOW_BITS = 15 + 16;
+
+static const int DEFAULT_MEM_LEVEL = 8;
+
+GzipSpanEncoder::GzipSpanEncoder(SpanEncoderPtr &&encoder,
+                                 int compression_level)
+    : encoder_{std::move(encoder)} {
+  std::memset(&stream_, 0, sizeof(stream_));
+  if (deflateInit2(&stream_, compression_level, Z_DEFLATED, GZIP_WINDOW_BITS,
+                   DEFAULT_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::bad_alloc{};
+  }
+  // Leave room for the null terminator added by GetString().
+  scratch_.Reserve(SCRATCH_SIZE + 1);
+}
+
+GzipSpanEncoder::~GzipSpanEncoder() { deflateEnd(&stream_); }
+
+void GzipSpanEncoder::startList(rapidjson::StringBuffer &out) {
+  out_ = &out;
+  deflateReset(&stream_);
+  scratch_.Clear();
+  encoder_->startList(scratch_);
+}
+
+void GzipSpanEncoder::addSpan(const Span &span) {
+  encoder_->addSpan(span);
+  if (scratch_.GetSize() >= SCRATCH_SIZE) {
+    deflateScratch(Z_NO_FLUSH);
+  }
+}
+
+void GzipSpanEncoder::endList() {
+  encoder_->endList();
+  deflateScratch(Z_FINISH);
+}
+
+void GzipSpanEncoder::compress(const char *data, size_t size,
+                               rapidjson::StringBuffer &out) {
+  out_ = &out;
+  deflateReset(&stream_);
+  deflateData(data, size, Z_FINISH);
+}
+
+void GzipSpanEncoder::deflateScratch(int flush) {
+  deflateData(scratch_.GetString(), scratch_.GetSize(), flush);
+  scratch_.Clear();
+}
+
+void GzipSpanEncoder::deflateData(const char *data, size_t size, int flush) {
+  // zlib doesn't modify its input, but only takes a non-const pointer to it.
+  stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  stream_.avail_in = static_cast<uInt>(size);
+  do {
+    // Deflate straight into the output buffer, then give back what wasn't
+    // used.
+    stream_.next_out =
+        reinterpret_cast<Bytef *>(out_->Push(OUTPUT_CHUNK_SIZE));
+    stream_.avail_out = static_cast<uInt>(OUTPUT_CHUNK_SIZE);
+    deflate(&stream_, flush);
+    out_->Pop(stream_.avail_out);
+  } while (stream_.avail_out == 0);
+}
+} // namespace zipkin
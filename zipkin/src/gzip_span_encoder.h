@@ -0,0 +1,76 @@
+#pragma once
+
+#include "span_encoder.h"
+
+#include <zlib.h>
+
+namespace zipkin {
+/**
+ * Wraps another encoder and compresses its output with gzip, for collectors
+ * that accept "Content-Encoding: gzip".
+ *
+ * The wrapped encoder writes into a small scratch buffer, which is deflated
+ * into the output each time it fills up. The uncompressed list of spans is
+ * therefore never held in memory in full, only a chunk of it.
+ */
+class GzipSpanEncoder : public SpanEncoder {
+public:
+  /**
+   * Constructor.
+   *
+   * @param encoder The encoder whose output is compressed.
+   * @param compression_level The zlib compression level, from 1 (fastest) to
+   * 9 (smallest).
+   *
+   * Throws std::bad_alloc if zlib can't be initialized.
+   */
+  GzipSpanEncoder(SpanEncoderPtr &&encoder, int compression_level);
+
+  /**
+   * Destructor.
+   */
+  ~GzipSpanEncoder();
+
+  GzipSpanEncoder(const GzipSpanEncoder &) = delete;
+  GzipSpanEncoder &operator=(const GzipSpanEncoder &) = delete;
+
+  /**
+   * Implementation of zipkin::SpanEncoder::contentType().
+   */
+  const char *contentType() const override { return encoder_->contentType(); }
+
+  /**
+   * Implementation of zipkin::SpanEncoder::startList().
+   */
+  void startList(rapidjson::StringBuffer &out) override;
+
+  /**
+   * Implementation of zipkin::SpanEncoder::addSpan().
+   */
+  void addSpan(const Span &span) override;
+
+  /**
+   * Implementation of zipkin::SpanEncoder::endList().
+   */
+  void endList() override;
+
+  /**
+   * Compresses spans that were already encoded by the wrapped encoder's
+   * format.
+   *
+   * @param data The encoded list of spans.
+   * @param size The size of the encoded list.
+   * @param out The buffer the compressed list is appended to.
+   */
+  void compress(const char *data, size_t size, rapidjson::StringBuffer &out);
+
+private:
+  SpanEncoderPtr encoder_;
+  z_stream stream_;
+  rapidjson::StringBuffer scratch_;
+  rapidjson::StringBuffer *out_ = nullptr;
+
+  void deflateData(const char *data, size_t size, int flush);
+  void deflateScratch(int flush);
+};
+} // namespace zipkin
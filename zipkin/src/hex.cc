@@ -75,6 +75,25 @@ std::string Hex::uint64ToHex(uint64_t value) {
   return encode(&data[0], data.size());
 }
 
+void Hex::uint64ToHex(uint64_t value, char *out) {
+  static const char *const digits = "0123456789abcdef";
+
+  for (int i = 15; i >= 0; --i) {
+    out[i] = digits[value & 0xf];
+    value >>= 4;
+  }
+}
+
+size_t Hex::traceIdToHex(const TraceId &trace_id, char *out) {
+  if (trace_id.high() == 0) {
+    uint64ToHex(trace_id.low(), out);
+    return 16;
+  }
+  uint64ToHex(trace_id.high(), out);
+  uint64ToHex(trace_id.low(), out + 16);
+  return 32;
+}
+
 std::string Hex::traceIdToHex(const TraceId &trace_id) {
   std::string result;
   if (trace_id.high() == 0) {
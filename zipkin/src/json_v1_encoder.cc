@@ -0,0 +1,123 @@
+#include "json_v1_encoder.h"
+
+#include "zipkin_json_field_names.h"
+
+namespace zipkin {
+void JsonV1Encoder::writeEndpoint(JsonWriter &writer,
+                                  const Endpoint &endpoint) {
+  const auto &field_names = ZipkinJsonFieldNames::get();
+  const auto &address = endpoint.address();
+  writer.StartObject();
+  if (!address.valid()) {
+    writeKey(writer, field_names.ENDPOINT_IPV4);
+    writer.String("", 0);
+    writeKey(writer, field_names.ENDPOINT_PORT);
+    writer.Uint(0);
+  } else {
+    if (address.version() == IpVersion::v4) {
+      // IPv4
+      writeKey(writer, field_names.ENDPOINT_IPV4);
+    } else {
+      // IPv6
+      writeKey(writer, field_names.ENDPOINT_IPV6);
+    }
+    writeString(writer, address.addressAsString());
+    writeKey(writer, field_names.ENDPOINT_PORT);
+    writer.Uint(address.port());
+  }
+  writeKey(writer, field_names.ENDPOINT_SERVICE_NAME);
+  writeString(writer, endpoint.serviceName());
+  writer.EndObject();
+}
+
+void JsonV1Encoder::writeAnnotation(JsonWriter &writer,
+                                    const Annotation &annotation) {
+  const auto &field_names = ZipkinJsonFieldNames::get();
+  writer.StartObject();
+  writeKey(writer, field_names.ANNOTATION_TIMESTAMP);
+  writer.Uint64(annotation.timestamp());
+  writeKey(writer, field_names.ANNOTATION_VALUE);
+  writeString(writer, annotation.value());
+  if (annotation.isSetEndpoint()) {
+    writeKey(writer, field_names.ANNOTATION_ENDPOINT);
+    writeEndpoint(writer, annotation.endpoint());
+  }
+  writer.EndObject();
+}
+
+void JsonV1Encoder::writeBinaryAnnotation(JsonWriter &writer,
+                                          const BinaryAnnotation &annotation) {
+  const auto &field_names = ZipkinJsonFieldNames::get();
+  writer.StartObject();
+  writeKey(writer, field_names.BINARY_ANNOTATION_KEY);
+  writeString(writer, annotation.key());
+  writeKey(writer, field_names.BINARY_ANNOTATION_VALUE);
+  switch (annotation.annotationType()) {
+  case STRING:
+    writeString(writer, annotation.valueString());
+    break;
+  case BOOL:
+    writer.Bool(annotation.valueBool());
+    break;
+  case INT64:
+    writer.Int64(annotation.valueInt64());
+    break;
+  case DOUBLE:
+    writer.Double(annotation.valueDouble());
+    break;
+  }
+
+  if (annotation.annotationType() == INT64) {
+    writeKey(writer, field_names.BINARY_ANNOTATION_TYPE);
+    writeString(writer, field_names.BINARY_ANNOTATION_TYPE_INT64);
+  }
+
+  if (annotation.isSetEndpoint()) {
+    writeKey(writer, field_names.BINARY_ANNOTATION_ENDPOINT);
+    writeEndpoint(writer, annotation.endpoint());
+  }
+  writer.EndObject();
+}
+
+void JsonV1Encoder::writeSpan(JsonWriter &writer, const Span &span) {
+  const auto &field_names = ZipkinJsonFieldNames::get();
+  writer.StartObject();
+  writeKey(writer, field_names.SPAN_TRACE_ID);
+  writeHex(writer, span.traceId());
+  writeKey(writer, field_names.SPAN_NAME);
+  writeString(writer, span.name());
+  writeKey(writer, field_names.SPAN_ID);
+  writeHex(writer, span.id());
+
+  if (span.isSetParentId() && !span.parentId().empty()) {
+    writeKey(writer, field_names.SPAN_PARENT_ID);
+    writeHex(writer, span.parentId());
+  }
+
+  if (span.isSetTimestamp()) {
+    writeKey(writer, field_names.SPAN_TIMESTAMP);
+    writer.Int64(span.timestamp());
+  }
+
+  if (span.isSetDuration()) {
+    writeKey(writer, field_names.SPAN_DURATION);
+    writer.Int64(span.duration());
+  }
+
+  writeKey(writer, field_names.SPAN_ANNOTATIONS);
+  writer.StartArray();
+  for (const auto &annotation : span.annotations()) {
+    writeAnnotation(writer, annotation);
+  }
+  writer.EndArray();
+
+  writeKey(writer, field_names.SPAN_BINARY_ANNOTATIONS);
+  writer.StartArray();
+  for (const auto &annotation : span.binaryAnnotations()) {
+    writeBinaryAnnotation(writer, annotation);
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+}
+} // namespace zipkin
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "span_encoder.h"
+
+namespace zipkin {
+/**
+ * Serializes Zipkin spans into the v1 JSON format.
+ *
+ * Every object is streamed into the given writer in a single pass, so that
+ * a whole batch of spans, including their annotations, binary annotations and
+ * endpoints, can be written without any intermediate strings.
+ */
+class JsonV1Encoder : public JsonSpanEncoder {
+public:
+  /**
+   * Writes the given endpoint as a JSON object.
+   */
+  static void writeEndpoint(JsonWriter &writer, const Endpoint &endpoint);
+
+  /**
+   * Writes the given annotation, with its endpoint, as a JSON object.
+   */
+  static void writeAnnotation(JsonWriter &writer, const Annotation &annotation);
+
+  /**
+   * Writes the given binary annotation, with its endpoint, as a JSON object.
+   */
+  static void writeBinaryAnnotation(JsonWriter &writer,
+                                    const BinaryAnnotation &annotation);
+
+  /**
+   * Writes the given span, with all of its annotations, as a JSON object.
+   */
+  static void writeSpan(JsonWriter &writer, const Span &span);
+
+protected:
+  /**
+   * Implementation of zipkin::JsonSpanEncoder::writeSpanObject().
+   */
+  void writeSpanObject(JsonWriter &writer, const Span &span) override {
+    writeSpan(writer, span);
+  }
+};
+} // namespace zipkin
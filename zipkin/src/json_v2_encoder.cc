@@ -0,0 +1,134 @@
+#include "json_v2_encoder.h"
+
+#include "v2_span_view.h"
+#include "zipkin_json_field_names.h"
+
+namespace zipkin {
+void JsonV2Encoder::writeEndpoint(JsonWriter &writer,
+                                  const Endpoint &endpoint) {
+  const auto &field_names = ZipkinJsonFieldNames::get();
+  const auto &address = endpoint.address();
+  writer.StartObject();
+  if (!endpoint.serviceName().empty()) {
+    writeKey(writer, field_names.ENDPOINT_SERVICE_NAME);
+    writeString(writer, endpoint.serviceName());
+  }
+  if (address.valid()) {
+    if (address.version() == IpVersion::v4) {
+      writeKey(writer, field_names.ENDPOINT_IPV4);
+    } else {
+      writeKey(writer, field_names.ENDPOINT_IPV6);
+    }
+    size_t host_size;
+    auto host = V2SpanView::host(address, host_size);
+    writer.String(host, static_cast<rapidjson::SizeType>(host_size));
+    if (address.port() != 0) {
+      writeKey(writer, field_names.ENDPOINT_PORT);
+      writer.Uint(address.port());
+    }
+  }
+  writer.EndObject();
+}
+
+void JsonV2Encoder::writeSpan(JsonWriter &writer, const Span &span) {
+  const auto &field_names = ZipkinJsonFieldNames::get();
+  V2SpanView view{span};
+  writer.StartObject();
+  writeKey(writer, field_names.SPAN_TRACE_ID);
+  writeHex(writer, span.traceId());
+
+  if (span.isSetParentId() && !span.parentId().empty()) {
+    writeKey(writer, field_names.SPAN_PARENT_ID);
+    writeHex(writer, span.parentId());
+  }
+
+  writeKey(writer, field_names.SPAN_ID);
+  writeHex(writer, span.id());
+
+  switch (view.kind()) {
+  case SpanKind::CLIENT:
+    writeKey(writer, field_names.SPAN_KIND);
+    writeString(writer, field_names.SPAN_KIND_CLIENT);
+    break;
+  case SpanKind::SERVER:
+    writeKey(writer, field_names.SPAN_KIND);
+    writeString(writer, field_names.SPAN_KIND_SERVER);
+    break;
+  case SpanKind::UNSPECIFIED:
+    break;
+  }
+
+  if (!span.name().empty()) {
+    writeKey(writer, field_names.SPAN_NAME);
+    writeString(writer, span.name());
+  }
+
+  if (span.isSetTimestamp()) {
+    writeKey(writer, field_names.SPAN_TIMESTAMP);
+    writer.Int64(span.timestamp());
+  }
+
+  if (span.isSetDuration()) {
+    writeKey(writer, field_names.SPAN_DURATION);
+    writer.Int64(span.duration());
+  }
+
+  if (view.localEndpoint() != nullptr) {
+    writeKey(writer, field_names.SPAN_LOCAL_ENDPOINT);
+    writeEndpoint(writer, *view.localEndpoint());
+  }
+
+  if (view.remoteEndpoint() != nullptr) {
+    writeKey(writer, field_names.SPAN_REMOTE_ENDPOINT);
+    writeEndpoint(writer, *view.remoteEndpoint());
+  }
+
+  bool has_annotations = false;
+  for (const auto &annotation : span.annotations()) {
+    if (V2SpanView::isCoreAnnotation(annotation)) {
+      continue;
+    }
+    if (!has_annotations) {
+      writeKey(writer, field_names.SPAN_ANNOTATIONS);
+      writer.StartArray();
+      has_annotations = true;
+    }
+    writer.StartObject();
+    writeKey(writer, field_names.ANNOTATION_TIMESTAMP);
+    writer.Uint64(annotation.timestamp());
+    writeKey(writer, field_names.ANNOTATION_VALUE);
+    writeString(writer, annotation.value());
+    writer.EndObject();
+  }
+  if (has_annotations) {
+    writer.EndArray();
+  }
+
+  bool has_tags = false;
+  for (const auto &annotation : span.binaryAnnotations()) {
+    if (!V2SpanView::isTag(annotation)) {
+      continue;
+    }
+    if (!has_tags) {
+      writeKey(writer, field_names.SPAN_TAGS);
+      writer.StartObject();
+      has_tags = true;
+    }
+    writeKey(writer, annotation.key());
+    char buffer[32];
+    size_t value_size;
+    auto value = V2SpanView::tagValue(annotation, buffer, value_size);
+    writer.String(value, static_cast<rapidjson::SizeType>(value_size));
+  }
+  if (has_tags) {
+    writer.EndObject();
+  }
+
+  if (span.debug()) {
+    writeKey(writer, field_names.SPAN_DEBUG);
+    writer.Bool(true);
+  }
+
+  writer.EndObject();
+}
+} // namespace zipkin
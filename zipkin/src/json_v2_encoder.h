@@ -0,0 +1,33 @@
+#pragma once
+
+#include "span_encoder.h"
+
+namespace zipkin {
+/**
+ * Serializes Zipkin spans into the v2 JSON format.
+ *
+ * Each span carries its kind and a single localEndpoint; annotations are
+ * written without endpoints and binary annotations become a flat "tags"
+ * object. See V2SpanView for how the v1 span model is mapped.
+ */
+class JsonV2Encoder : public JsonSpanEncoder {
+public:
+  /**
+   * Writes the given endpoint as a JSON object, omitting empty fields.
+   */
+  static void writeEndpoint(JsonWriter &writer, const Endpoint &endpoint);
+
+  /**
+   * Writes the given span as a JSON object.
+   */
+  static void writeSpan(JsonWriter &writer, const Span &span);
+
+protected:
+  /**
+   * Implementation of zipkin::JsonSpanEncoder::writeSpanObject().
+   */
+  void writeSpanObject(JsonWriter &writer, const Span &span) override {
+    writeSpan(writer, span);
+  }
+};
+} // namespace zipkin
@@ -0,0 +1,309 @@
+#include "proto3_encoder.h"
+
+#include "v2_span_view.h"
+
+#ifdef _MSC_VER
+#include <Ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+#include <cstring>
+
+namespace zipkin {
+// Wire types, see https://developers.google.com/protocol-buffers/docs/encoding
+static const uint32_t WIRE_TYPE_VARINT = 0;
+static const uint32_t WIRE_TYPE_FIXED64 = 1;
+static const uint32_t WIRE_TYPE_LENGTH_DELIMITED = 2;
+
+// Field numbers from zipkin.proto3
+static const uint32_t LIST_OF_SPANS_SPANS = 1;
+
+static const uint32_t SPAN_TRACE_ID = 1;
+static const uint32_t SPAN_PARENT_ID = 2;
+static const uint32_t SPAN_ID = 3;
+static const uint32_t SPAN_KIND = 4;
+static const uint32_t SPAN_NAME = 5;
+static const uint32_t SPAN_TIMESTAMP = 6;
+static const uint32_t SPAN_DURATION = 7;
+static const uint32_t SPAN_LOCAL_ENDPOINT = 8;
+static const uint32_t SPAN_REMOTE_ENDPOINT = 9;
+static const uint32_t SPAN_ANNOTATIONS = 10;
+static const uint32_t SPAN_TAGS = 11;
+static const uint32_t SPAN_DEBUG = 12;
+
+static const uint32_t ENDPOINT_SERVICE_NAME = 1;
+static const uint32_t ENDPOINT_IPV4 = 2;
+static const uint32_t ENDPOINT_IPV6 = 3;
+static const uint32_t ENDPOINT_PORT = 4;
+
+static const uint32_t ANNOTATION_TIMESTAMP = 1;
+static const uint32_t ANNOTATION_VALUE = 2;
+
+static const uint32_t MAP_ENTRY_KEY = 1;
+static const uint32_t MAP_ENTRY_VALUE = 2;
+
+namespace {
+/**
+ * Binary form of an endpoint's address, as stored in the ipv4/ipv6 fields.
+ */
+struct EndpointAddress {
+  explicit EndpointAddress(const Endpoint *endpoint);
+
+  uint32_t field = 0;
+  size_t size = 0;
+  unsigned char bytes[16];
+};
+
+/**
+ * Writes protobuf primitives into a rapidjson::StringBuffer.
+ */
+class Proto3Writer {
+public:
+  explicit Proto3Writer(rapidjson::StringBuffer &out) : out_(out) {}
+
+  void writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+      out_.Put(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    out_.Put(static_cast<char>(value));
+  }
+
+  void writeTag(uint32_t field, uint32_t wire_type) {
+    writeVarint((field << 3) | wire_type);
+  }
+
+  void writeFixed64(uint32_t field, uint64_t value) {
+    writeTag(field, WIRE_TYPE_FIXED64);
+    auto data = out_.Push(8);
+    for (int i = 0; i < 8; ++i) {
+      data[i] = static_cast<char>(value >> (8 * i));
+    }
+  }
+
+  void writeBytes(uint32_t field, const void *data, size_t size) {
+    writeTag(field, WIRE_TYPE_LENGTH_DELIMITED);
+    writeVarint(size);
+    std::memcpy(out_.Push(size), data, size);
+  }
+
+  void writeId(uint32_t field, uint64_t id) {
+    writeTag(field, WIRE_TYPE_LENGTH_DELIMITED);
+    writeVarint(8);
+    writeBigEndian(id);
+  }
+
+  void writeTraceId(uint32_t field, const TraceId &trace_id) {
+    writeTag(field, WIRE_TYPE_LENGTH_DELIMITED);
+    if (trace_id.high() == 0) {
+      writeVarint(8);
+    } else {
+      writeVarint(16);
+      writeBigEndian(trace_id.high());
+    }
+    writeBigEndian(trace_id.low());
+  }
+
+  void writeMessageHeader(uint32_t field, size_t size) {
+    writeTag(field, WIRE_TYPE_LENGTH_DELIMITED);
+    writeVarint(size);
+  }
+
+private:
+  rapidjson::StringBuffer &out_;
+
+  void writeBigEndian(uint64_t value) {
+    auto data = out_.Push(8);
+    for (int i = 7; i >= 0; --i) {
+      data[i] = static_cast<char>(value);
+      value >>= 8;
+    }
+  }
+};
+} // namespace
+
+EndpointAddress::EndpointAddress(const Endpoint *endpoint) {
+  if (endpoint == nullptr || !endpoint->address().valid()) {
+    return;
+  }
+  const auto &address = endpoint->address();
+  size_t host_size;
+  auto host = V2SpanView::host(address, host_size);
+  char host_string[INET6_ADDRSTRLEN];
+  if (host_size >= sizeof(host_string)) {
+    return;
+  }
+  std::memcpy(host_string, host, host_size);
+  host_string[host_size] = '\0';
+  if (address.version() == IpVersion::v4) {
+    if (inet_pton(AF_INET, host_string, bytes) == 1) {
+      field = ENDPOINT_IPV4;
+      size = 4;
+    }
+  } else if (inet_pton(AF_INET6, host_string, bytes) == 1) {
+    field = ENDPOINT_IPV6;
+    size = 16;
+  }
+}
+
+static size_t varintSize(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+// Size of a length-delimited field with a one-byte tag.
+static size_t lengthDelimitedSize(size_t size) {
+  return 1 + varintSize(size) + size;
+}
+
+static size_t endpointSize(const Endpoint &endpoint,
+                           const EndpointAddress &address) {
+  size_t size = 0;
+  if (!endpoint.serviceName().empty()) {
+    size += lengthDelimitedSize(endpoint.serviceName().size());
+  }
+  if (address.size != 0) {
+    size += lengthDelimitedSize(address.size);
+    if (endpoint.address().port() != 0) {
+      size += 1 + varintSize(endpoint.address().port());
+    }
+  }
+  return size;
+}
+
+static void writeEndpoint(Proto3Writer &writer, uint32_t field,
+                          const Endpoint &endpoint,
+                          const EndpointAddress &address) {
+  writer.writeMessageHeader(field, endpointSize(endpoint, address));
+  const auto &service_name = endpoint.serviceName();
+  if (!service_name.empty()) {
+    writer.writeBytes(ENDPOINT_SERVICE_NAME, service_name.data(),
+                      service_name.size());
+  }
+  if (address.size != 0) {
+    writer.writeBytes(address.field, address.bytes, address.size);
+    if (endpoint.address().port() != 0) {
+      writer.writeTag(ENDPOINT_PORT, WIRE_TYPE_VARINT);
+      writer.writeVarint(endpoint.address().port());
+    }
+  }
+}
+
+static size_t annotationSize(const Annotation &annotation) {
+  return 9 + lengthDelimitedSize(annotation.value().size());
+}
+
+static size_t tagSize(const BinaryAnnotation &annotation, size_t value_size) {
+  return lengthDelimitedSize(annotation.key().size()) +
+         lengthDelimitedSize(value_size);
+}
+
+void Proto3Encoder::addSpan(const Span &span) {
+  V2SpanView view{span};
+  EndpointAddress local_address{view.localEndpoint()};
+  EndpointAddress remote_address{view.remoteEndpoint()};
+  bool has_parent_id = span.isSetParentId() && !span.parentId().empty();
+
+  // Nested messages are prefixed with their size, so compute the size of the
+  // span before writing it.
+  size_t size = lengthDelimitedSize(span.traceId().high() == 0 ? 8 : 16) +
+                lengthDelimitedSize(8);
+  if (has_parent_id) {
+    size += lengthDelimitedSize(8);
+  }
+  if (view.kind() != SpanKind::UNSPECIFIED) {
+    size += 2;
+  }
+  if (!span.name().empty()) {
+    size += lengthDelimitedSize(span.name().size());
+  }
+  if (span.isSetTimestamp()) {
+    size += 9;
+  }
+  if (span.isSetDuration()) {
+    size += 1 + varintSize(static_cast<uint64_t>(span.duration()));
+  }
+  if (view.localEndpoint() != nullptr) {
+    size += lengthDelimitedSize(
+        endpointSize(*view.localEndpoint(), local_address));
+  }
+  if (view.remoteEndpoint() != nullptr) {
+    size += lengthDelimitedSize(
+        endpointSize(*view.remoteEndpoint(), remote_address));
+  }
+  for (const auto &annotation : span.annotations()) {
+    if (!V2SpanView::isCoreAnnotation(annotation)) {
+      size += lengthDelimitedSize(annotationSize(annotation));
+    }
+  }
+  char buffer[32];
+  size_t value_size;
+  for (const auto &annotation : span.binaryAnnotations()) {
+    if (V2SpanView::isTag(annotation)) {
+      V2SpanView::tagValue(annotation, buffer, value_size);
+      size += lengthDelimitedSize(tagSize(annotation, value_size));
+    }
+  }
+  if (span.debug()) {
+    size += 2;
+  }
+
+  Proto3Writer writer{*out_};
+  writer.writeMessageHeader(LIST_OF_SPANS_SPANS, size);
+  writer.writeTraceId(SPAN_TRACE_ID, span.traceId());
+  if (has_parent_id) {
+    writer.writeId(SPAN_PARENT_ID, span.parentId().low());
+  }
+  writer.writeId(SPAN_ID, span.id());
+  if (view.kind() != SpanKind::UNSPECIFIED) {
+    writer.writeTag(SPAN_KIND, WIRE_TYPE_VARINT);
+    writer.writeVarint(static_cast<uint64_t>(view.kind()));
+  }
+  if (!span.name().empty()) {
+    writer.writeBytes(SPAN_NAME, span.name().data(), span.name().size());
+  }
+  if (span.isSetTimestamp()) {
+    writer.writeFixed64(SPAN_TIMESTAMP,
+                        static_cast<uint64_t>(span.timestamp()));
+  }
+  if (span.isSetDuration()) {
+    writer.writeTag(SPAN_DURATION, WIRE_TYPE_VARINT);
+    writer.writeVarint(static_cast<uint64_t>(span.duration()));
+  }
+  if (view.localEndpoint() != nullptr) {
+    writeEndpoint(writer, SPAN_LOCAL_ENDPOINT, *view.localEndpoint(),
+                  local_address);
+  }
+  if (view.remoteEndpoint() != nullptr) {
+    writeEndpoint(writer, SPAN_REMOTE_ENDPOINT, *view.remoteEndpoint(),
+                  remote_address);
+  }
+  for (const auto &annotation : span.annotations()) {
+    if (V2SpanView::isCoreAnnotation(annotation)) {
+      continue;
+    }
+    writer.writeMessageHeader(SPAN_ANNOTATIONS, annotationSize(annotation));
+    writer.writeFixed64(ANNOTATION_TIMESTAMP, annotation.timestamp());
+    writer.writeBytes(ANNOTATION_VALUE, annotation.value().data(),
+                      annotation.value().size());
+  }
+  for (const auto &annotation : span.binaryAnnotations()) {
+    if (!V2SpanView::isTag(annotation)) {
+      continue;
+    }
+    auto value = V2SpanView::tagValue(annotation, buffer, value_size);
+    writer.writeMessageHeader(SPAN_TAGS, tagSize(annotation, value_size));
+    writer.writeBytes(MAP_ENTRY_KEY, annotation.key().data(),
+                      annotation.key().size());
+    writer.writeBytes(MAP_ENTRY_VALUE, value, value_size);
+  }
+  if (span.debug()) {
+    writer.writeTag(SPAN_DEBUG, WIRE_TYPE_VARINT);
+    writer.writeVarint(1);
+  }
+}
+} // namespace zipkin
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "span_encoder.h"
+
+namespace zipkin {
+/**
+ * Serializes Zipkin spans as a zipkin.proto3.ListOfSpans message.
+ *
+ * The protobuf wire format is written by hand, so there is no dependency on
+ * libprotobuf. IDs are written as raw big-endian bytes and strings are copied
+ * straight from the span, so no hex strings are built. The span model is
+ * mapped the same way as for the v2 JSON format; see V2SpanView.
+ */
+class Proto3Encoder : public SpanEncoder {
+public:
+  /**
+   * Implementation of zipkin::SpanEncoder::contentType().
+   */
+  const char *contentType() const override { return "application/x-protobuf"; }
+
+  /**
+   * Implementation of zipkin::SpanEncoder::startList().
+   */
+  void startList(rapidjson::StringBuffer &out) override { out_ = &out; }
+
+  /**
+   * Implementation of zipkin::SpanEncoder::addSpan().
+   */
+  void addSpan(const Span &span) override;
+
+  /**
+   * Implementation of zipkin::SpanEncoder::endList().
+   */
+  void endList() override {}
+
+private:
+  rapidjson::StringBuffer *out_ = nullptr;
+};
+} // namespace zipkin
@@ -0,0 +1,210 @@
+#include "shm_span_ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace zipkin {
+// Marks a ring whose header has been initialized by its creator.
+static const uint32_t RING_MAGIC = 0x7a6b5231;
+
+// Records start on their own cache line after the header.
+static const size_t DATA_OFFSET = 256;
+
+// Each record is preceded by its size and its number of spans.
+static const size_t RECORD_HEADER_SIZE = 8;
+
+// How long to wait for another process to finish creating the ring.
+static const int MAX_ATTACH_ATTEMPTS = 1000;
+static const std::chrono::milliseconds ATTACH_RETRY_INTERVAL{1};
+
+static std::system_error makeSystemError(const char *what) {
+  return std::system_error{errno, std::system_category(), what};
+}
+
+class ShmSpanRing::Lock {
+public:
+  explicit Lock(pthread_mutex_t &mutex) : mutex_(mutex) {
+#ifdef __linux__
+    if (pthread_mutex_lock(&mutex_) == EOWNERDEAD) {
+      // The previous owner died while holding the lock. Positions are only
+      // advanced after a record is complete, so the ring is still valid.
+      pthread_mutex_consistent(&mutex_);
+    }
+#else
+    pthread_mutex_lock(&mutex_);
+#endif
+  }
+
+  ~Lock() { pthread_mutex_unlock(&mutex_); }
+
+private:
+  pthread_mutex_t &mutex_;
+};
+
+ShmSpanRing::ShmSpanRing(const std::string &name, size_t size,
+                         SpanEncoding encoding) {
+  static_assert(sizeof(Header) <= DATA_OFFSET, "ring header is too large");
+  file_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (file_ >= 0) {
+    create(size, encoding);
+  } else if (errno == EEXIST) {
+    file_ = shm_open(name.c_str(), O_RDWR, 0600);
+    if (file_ < 0) {
+      throw makeSystemError("shm_open");
+    }
+    attach();
+    if (this->encoding() != encoding) {
+      release();
+      throw std::runtime_error{name + ": ring holds another span encoding"};
+    }
+  } else {
+    throw makeSystemError("shm_open");
+  }
+}
+
+ShmSpanRing::~ShmSpanRing() { release(); }
+
+void ShmSpanRing::release() {
+  if (header_ != nullptr) {
+    munmap(header_, mapping_size_);
+    header_ = nullptr;
+  }
+  if (file_ >= 0) {
+    close(file_);
+    file_ = -1;
+  }
+}
+
+void ShmSpanRing::create(size_t size, SpanEncoding encoding) {
+  mapping_size_ = DATA_OFFSET + std::max<size_t>(size, RECORD_HEADER_SIZE);
+  void *mapping = MAP_FAILED;
+  if (ftruncate(file_, static_cast<off_t>(mapping_size_)) == 0) {
+    mapping = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   file_, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    auto error = makeSystemError("mmap");
+    release();
+    throw error;
+  }
+  header_ = static_cast<Header *>(mapping);
+  data_ = static_cast<char *>(mapping) + DATA_OFFSET;
+
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+  pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+#endif
+  pthread_mutex_init(&header_->mutex, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+  header_->encoding = static_cast<uint32_t>(encoding);
+  header_->capacity = mapping_size_ - DATA_OFFSET;
+  header_->write_pos = 0;
+  header_->read_pos = 0;
+  header_->num_records_dropped = 0;
+  header_->magic.store(RING_MAGIC, std::memory_order_release);
+}
+
+void ShmSpanRing::attach() {
+  // The creator may not have sized or initialized the ring yet.
+  struct stat file_status;
+  for (int i = 0; i < MAX_ATTACH_ATTEMPTS; ++i) {
+    if (fstat(file_, &file_status) != 0) {
+      throw makeSystemError("fstat");
+    }
+    if (static_cast<size_t>(file_status.st_size) > DATA_OFFSET) {
+      break;
+    }
+    std::this_thread::sleep_for(ATTACH_RETRY_INTERVAL);
+  }
+  mapping_size_ = static_cast<size_t>(file_status.st_size);
+  if (mapping_size_ <= DATA_OFFSET) {
+    release();
+    throw std::runtime_error{"shared memory ring was never initialized"};
+  }
+  auto mapping = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, file_, 0);
+  if (mapping == MAP_FAILED) {
+    auto error = makeSystemError("mmap");
+    release();
+    throw error;
+  }
+  header_ = static_cast<Header *>(mapping);
+  data_ = static_cast<char *>(mapping) + DATA_OFFSET;
+  for (int i = 0; i < MAX_ATTACH_ATTEMPTS; ++i) {
+    if (header_->magic.load(std::memory_order_acquire) == RING_MAGIC) {
+      return;
+    }
+    std::this_thread::sleep_for(ATTACH_RETRY_INTERVAL);
+  }
+  release();
+  throw std::runtime_error{"shared memory ring was never initialized"};
+}
+
+void ShmSpanRing::copyIn(uint64_t position, const void *data, size_t size) {
+  auto offset = static_cast<size_t>(position % header_->capacity);
+  auto first_size = std::min<size_t>(size, header_->capacity - offset);
+  std::memcpy(data_ + offset, data, first_size);
+  std::memcpy(data_, static_cast<const char *>(data) + first_size,
+              size - first_size);
+}
+
+void ShmSpanRing::copyOut(uint64_t position, void *data, size_t size) const {
+  auto offset = static_cast<size_t>(position % header_->capacity);
+  auto first_size = std::min<size_t>(size, header_->capacity - offset);
+  std::memcpy(data, data_ + offset, first_size);
+  std::memcpy(static_cast<char *>(data) + first_size, data_,
+              size - first_size);
+}
+
+bool ShmSpanRing::write(const char *data, size_t size, uint32_t num_spans) {
+  Lock lock{header_->mutex};
+  auto free_size =
+      header_->capacity - (header_->write_pos - header_->read_pos);
+  if (RECORD_HEADER_SIZE + size > free_size) {
+    ++header_->num_records_dropped;
+    return false;
+  }
+  uint32_t record_header[2] = {static_cast<uint32_t>(size), num_spans};
+  copyIn(header_->write_pos, record_header, RECORD_HEADER_SIZE);
+  copyIn(header_->write_pos + RECORD_HEADER_SIZE, data, size);
+  header_->write_pos += RECORD_HEADER_SIZE + size;
+  return true;
+}
+
+bool ShmSpanRing::read(std::string &data, uint32_t &num_spans) {
+  Lock lock{header_->mutex};
+  if (header_->read_pos == header_->write_pos) {
+    return false;
+  }
+  uint32_t record_header[2];
+  copyOut(header_->read_pos, record_header, RECORD_HEADER_SIZE);
+  data.resize(record_header[0]);
+  copyOut(header_->read_pos + RECORD_HEADER_SIZE, &data[0], data.size());
+  num_spans = record_header[1];
+  header_->read_pos += RECORD_HEADER_SIZE + data.size();
+  return true;
+}
+
+SpanEncoding ShmSpanRing::encoding() const {
+  return static_cast<SpanEncoding>(header_->encoding);
+}
+
+uint64_t ShmSpanRing::numRecordsDropped() const {
+  Lock lock{header_->mutex};
+  return header_->num_records_dropped;
+}
+
+void ShmSpanRing::remove(const std::string &name) {
+  shm_unlink(name.c_str());
+}
+} // namespace zipkin
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <zipkin/tracer.h>
+
+#include <atomic>
+#include <pthread.h>
+#include <string>
+
+namespace zipkin {
+/**
+ * A ring buffer of encoded batches of spans in POSIX shared memory, so that
+ * many processes can hand spans to a single exporter process.
+ *
+ * The ring is created by whichever process opens it first; later processes
+ * map the existing segment. Each record holds one encoded list of spans, in
+ * the encoding the ring was created with. Records are written and read under
+ * a process-shared mutex. On Linux the mutex is robust, so a process that
+ * dies while holding it does not block the others; the ring's positions are
+ * only updated once a record has been copied, so they stay consistent.
+ *
+ * Writers never wait for room: a record that doesn't fit is dropped.
+ */
+class ShmSpanRing {
+public:
+  /**
+   * Opens the ring with the given name, creating it if it doesn't exist.
+   *
+   * @param name The name of the shared memory object, e.g. "/zipkin-spans".
+   * @param size The number of bytes available for records, if the ring is
+   * created. An existing ring keeps its size.
+   * @param encoding The encoding of the records. It must match the encoding
+   * of an existing ring.
+   *
+   * Throws std::system_error if the shared memory can't be opened or mapped,
+   * and std::runtime_error if an existing ring is invalid or was created with
+   * another encoding.
+   */
+  ShmSpanRing(const std::string &name, size_t size, SpanEncoding encoding);
+
+  /**
+   * Destructor. Unmaps the ring, which is left in place for other processes.
+   */
+  ~ShmSpanRing();
+
+  ShmSpanRing(const ShmSpanRing &) = delete;
+  ShmSpanRing &operator=(const ShmSpanRing &) = delete;
+
+  /**
+   * Appends a record.
+   *
+   * @param data The encoded spans.
+   * @param size The size of the encoded spans.
+   * @param num_spans The number of spans encoded.
+   * @return true if the record was added, or false if there was no room.
+   */
+  bool write(const char *data, size_t size, uint32_t num_spans);
+
+  /**
+   * Removes the oldest record.
+   *
+   * @param data Set to the encoded spans.
+   * @param num_spans Set to the number of spans encoded.
+   * @return true if a record was read, or false if the ring was empty.
+   */
+  bool read(std::string &data, uint32_t &num_spans);
+
+  /**
+   * @return the encoding of the records.
+   */
+  SpanEncoding encoding() const;
+
+  /**
+   * @return the number of records dropped by all writers because the ring
+   * was full.
+   */
+  uint64_t numRecordsDropped() const;
+
+  /**
+   * Removes the shared memory object with the given name. Processes that
+   * have it mapped keep using it.
+   */
+  static void remove(const std::string &name);
+
+private:
+  struct Header {
+    std::atomic<uint32_t> magic;
+    uint32_t encoding;
+    uint64_t capacity;
+    pthread_mutex_t mutex;
+    uint64_t write_pos;
+    uint64_t read_pos;
+    uint64_t num_records_dropped;
+  };
+
+  class Lock;
+
+  int file_ = -1;
+  size_t mapping_size_ = 0;
+  Header *header_ = nullptr;
+  char *data_ = nullptr;
+
+  void release();
+  void create(size_t size, SpanEncoding encoding);
+  void attach();
+  void copyIn(uint64_t position, const void *data, size_t size);
+  void copyOut(uint64_t position, void *data, size_t size) const;
+};
+} // namespace zipkin
@@ -1,31 +1,74 @@
 #include "span_buffer.h"
 
+#include "json_v1_encoder.h"
+
 namespace zipkin {
+static size_t estimateMemorySize(const Endpoint &endpoint) {
+  return endpoint.serviceName().size() +
+         endpoint.address().addressAsString().size();
+}
+
+size_t estimateMemorySize(const Span &span) {
+  size_t size = sizeof(Span) + span.name().size();
+  const auto &annotations = span.annotations();
+  size += annotations.capacity() * sizeof(Annotation);
+  for (const auto &annotation : annotations) {
+    size += annotation.value().size();
+    if (annotation.isSetEndpoint()) {
+      size += estimateMemorySize(annotation.endpoint());
+    }
+  }
+  const auto &binary_annotations = span.binaryAnnotations();
+  size += binary_annotations.capacity() * sizeof(BinaryAnnotation);
+  for (const auto &annotation : binary_annotations) {
+    size += annotation.key().size();
+    if (annotation.annotationType() == STRING) {
+      size += annotation.valueString().size();
+    }
+    if (annotation.isSetEndpoint()) {
+      size += estimateMemorySize(annotation.endpoint());
+    }
+  }
+  return size;
+}
+
 
-// TODO(fabolive): Need to avoid the copy to improve performance.
 bool SpanBuffer::addSpan(const Span &span) {
-  if (span_buffer_.size() == span_buffer_.capacity()) {
-    // Buffer full
+  if (isFull()) {
     return false;
   }
+  encoded_size_estimate_ += estimateEncodedSize(span);
+  memory_size_ += estimateMemorySize(span);
+  span_buffer_.push_back(span);
+
+  return true;
+}
+
+bool SpanBuffer::addSpan(Span &&span) {
+  if (isFull()) {
+    return false;
+  }
+  encoded_size_estimate_ += estimateEncodedSize(span);
+  memory_size_ += estimateMemorySize(span);
   span_buffer_.push_back(std::move(span));
 
   return true;
 }
 
 std::string SpanBuffer::toStringifiedJsonArray() {
-  std::string stringified_json_array = "[";
-
-  if (pendingSpans()) {
-    stringified_json_array += span_buffer_[0].toJson();
-    const uint64_t size = span_buffer_.size();
-    for (uint64_t i = 1; i < size; i++) {
-      stringified_json_array += ",";
-      stringified_json_array += span_buffer_[i].toJson();
-    }
-  }
-  stringified_json_array += "]";
+  rapidjson::StringBuffer buffer;
+  JsonV1Encoder encoder;
+  encode(encoder, buffer);
 
-  return stringified_json_array;
+  return std::string{buffer.GetString(), buffer.GetSize()};
+}
+
+void SpanBuffer::encode(SpanEncoder &encoder,
+                        rapidjson::StringBuffer &out) const {
+  encoder.startList(out);
+  for (const auto &span : span_buffer_) {
+    encoder.addSpan(span);
+  }
+  encoder.endList();
 }
 } // namespace zipkin
@@ -1,12 +1,24 @@
 #pragma once
 
+#include "span_encoder.h"
 #include <zipkin/zipkin_core_types.h>
 
 namespace zipkin {
+/**
+ * Estimates the memory used by a span, including its annotations, binary
+ * annotations and their strings.
+ *
+ * @param span The span to estimate.
+ * @return the estimated size in bytes.
+ */
+size_t estimateMemorySize(const Span &span);
 
 /**
  * This class implements a simple buffer to store Zipkin tracing spans
  * prior to flushing them.
+ *
+ * The buffer is bounded by a number of spans and, optionally, by the memory
+ * used by the spans it holds.
  */
 class SpanBuffer {
 public:
@@ -23,6 +35,18 @@ public:
    */
   SpanBuffer(uint64_t size) { allocateBuffer(size); }
 
+  /**
+   * Constructor that initializes a buffer with the given size and memory
+   * budget.
+   *
+   * @param size The desired buffer size.
+   * @param max_bytes The memory budget, as computed by estimateMemorySize(). If
+   * zero, the memory used is not limited.
+   */
+  SpanBuffer(uint64_t size, size_t max_bytes) : max_bytes_{max_bytes} {
+    allocateBuffer(size);
+  }
+
   /**
    * Allocates space for an empty buffer or resizes a previously-allocated one.
    *
@@ -36,40 +60,109 @@ public:
    * @param span The span to be added to the buffer.
    *
    * @return true if the span was successfully added, or false if the buffer was
-   * full.
+   * full. A span is accepted whenever the buffer is under its memory budget,
+   * so the budget can be exceeded by one span.
    */
   bool addSpan(const Span &span);
 
+  /**
+   * Moves the given Zipkin span into the buffer.
+   *
+   * @param span The span to be added to the buffer.
+   *
+   * @return true if the span was successfully added, or false if the buffer was
+   * full.
+   */
+  bool addSpan(Span &&span);
+
   /**
    * @return returns the number of spans that can be held in currently allocated
    * storage.
    */
   uint64_t spanCapacity() const { return span_buffer_.capacity(); }
 
+  /**
+   * @return true if no more spans can be added, either because the buffer
+   * holds as many spans as it has room for or because its memory budget is
+   * used up.
+   */
+  bool isFull() const {
+    return span_buffer_.size() == span_buffer_.capacity() ||
+           (max_bytes_ > 0 && memory_size_ >= max_bytes_);
+  }
+
+  /**
+   * @return the estimated memory used by the buffered spans.
+   */
+  size_t memorySize() const { return memory_size_; }
+
   /**
    * Empties the buffer. This method is supposed to be called when all buffered
    * spans have been sent to to the Zipkin service.
    */
-  void clear() { span_buffer_.clear(); }
+  void clear() {
+    span_buffer_.clear();
+    encoded_size_estimate_ = 0;
+    memory_size_ = 0;
+  }
 
   /**
-   * Swaps buffers.
+   * Swaps the buffered spans, and the storage allocated for them, with those
+   * of another buffer. Each buffer keeps its memory budget.
    */
-  void swap(SpanBuffer &other) { span_buffer_.swap(other.span_buffer_); }
+  void swap(SpanBuffer &other) {
+    span_buffer_.swap(other.span_buffer_);
+    std::swap(encoded_size_estimate_, other.encoded_size_estimate_);
+    std::swap(memory_size_, other.memory_size_);
+  }
 
   /**
    * @return the number of spans currently buffered.
    */
   uint64_t pendingSpans() { return span_buffer_.size(); }
 
+  /**
+   * @param index The position of a buffered span.
+   * @return the span at the given position.
+   */
+  const Span &span(size_t index) const { return span_buffer_[index]; }
+
+  /**
+   * Moves a span out of the buffer, leaving an empty span in its place until
+   * the buffer is cleared.
+   *
+   * @param index The position of a buffered span.
+   * @return the span at the given position.
+   */
+  Span takeSpan(size_t index) { return std::move(span_buffer_[index]); }
+
+  /**
+   * @return an estimate of the size of the buffered spans once encoded. It is
+   * accumulated as spans are added, so that a transporter can size its output
+   * buffer before encoding.
+   */
+  size_t encodedSizeEstimate() const { return encoded_size_estimate_; }
+
   /**
    * @return the contents of the buffer as a stringified array of JSONs, where
-   * each JSON in the array corresponds to one Zipkin span.
+   * each JSON in the array corresponds to one Zipkin span. All spans are
+   * streamed into a single writer.
    */
   std::string toStringifiedJsonArray();
 
+  /**
+   * Encodes the contents of the buffer as a list of spans.
+   *
+   * @param encoder The encoder for the desired wire format.
+   * @param out The buffer the encoded list is appended to.
+   */
+  void encode(SpanEncoder &encoder, rapidjson::StringBuffer &out) const;
+
 private:
   // We use a pre-allocated vector to improve performance
   std::vector<Span> span_buffer_;
+  size_t encoded_size_estimate_ = 0;
+  size_t memory_size_ = 0;
+  size_t max_bytes_ = 0;
 };
 } // namespace zipkin
@@ -0,0 +1,99 @@
+#include "span_encoder.h"
+
+#include "json_v1_encoder.h"
+#include "json_v2_encoder.h"
+#include "proto3_encoder.h"
+
+#include <zipkin/hex.h>
+
+namespace zipkin {
+void writeKey(JsonWriter &writer, const std::string &key) {
+  writer.Key(key.data(), static_cast<rapidjson::SizeType>(key.size()));
+}
+
+void writeString(JsonWriter &writer, const std::string &value) {
+  writer.String(value.data(), static_cast<rapidjson::SizeType>(value.size()));
+}
+
+void writeHex(JsonWriter &writer, uint64_t value) {
+  char hex[16];
+  Hex::uint64ToHex(value, hex);
+  writer.String(hex, sizeof(hex));
+}
+
+void writeHex(JsonWriter &writer, const TraceId &value) {
+  char hex[32];
+  auto size = Hex::traceIdToHex(value, hex);
+  writer.String(hex, static_cast<rapidjson::SizeType>(size));
+}
+
+void JsonSpanEncoder::startList(rapidjson::StringBuffer &out) {
+  out_ = &out;
+  is_first_span_ = true;
+  out_->Put('[');
+}
+
+void JsonSpanEncoder::addSpan(const Span &span) {
+  if (!is_first_span_) {
+    out_->Put(',');
+  }
+  is_first_span_ = false;
+
+  // Each span is written as its own JSON document so that the list can be
+  // built up incrementally.
+  writer_.Reset(*out_);
+  writeSpanObject(writer_, span);
+}
+
+void JsonSpanEncoder::endList() { out_->Put(']'); }
+
+void JsonSpanEncoder::encodeObject(rapidjson::StringBuffer &out,
+                                   const Span &span) {
+  writer_.Reset(out);
+  writeSpanObject(writer_, span);
+}
+
+// Approximate sizes of the JSON v1 field names, punctuation and numbers that
+// surround the variable-length strings of each object.
+static const size_t SPAN_OVERHEAD = 200;
+static const size_t ANNOTATION_OVERHEAD = 40;
+static const size_t BINARY_ANNOTATION_OVERHEAD = 40;
+static const size_t ENDPOINT_OVERHEAD = 80;
+
+static size_t estimateEndpointSize(const Endpoint &endpoint) {
+  return ENDPOINT_OVERHEAD + endpoint.serviceName().size() +
+         endpoint.address().addressAsString().size();
+}
+
+size_t estimateEncodedSize(const Span &span) {
+  size_t size = SPAN_OVERHEAD + span.name().size();
+  for (const auto &annotation : span.annotations()) {
+    size += ANNOTATION_OVERHEAD + annotation.value().size();
+    if (annotation.isSetEndpoint()) {
+      size += estimateEndpointSize(annotation.endpoint());
+    }
+  }
+  for (const auto &annotation : span.binaryAnnotations()) {
+    size += BINARY_ANNOTATION_OVERHEAD + annotation.key().size();
+    if (annotation.annotationType() == STRING) {
+      size += annotation.valueString().size();
+    }
+    if (annotation.isSetEndpoint()) {
+      size += estimateEndpointSize(annotation.endpoint());
+    }
+  }
+  return size;
+}
+
+SpanEncoderPtr makeSpanEncoder(SpanEncoding encoding) {
+  switch (encoding) {
+  case SpanEncoding::JSON_V1:
+    return SpanEncoderPtr{new JsonV1Encoder{}};
+  case SpanEncoding::JSON_V2:
+    return SpanEncoderPtr{new JsonV2Encoder{}};
+  case SpanEncoding::PROTO3:
+    return SpanEncoderPtr{new Proto3Encoder{}};
+  }
+  return nullptr;
+}
+} // namespace zipkin
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <memory>
+
+#include <zipkin/tracer.h>
+#include <zipkin/zipkin_core_types.h>
+
+#include <zipkin/rapidjson/stringbuffer.h>
+#include <zipkin/rapidjson/writer.h>
+
+namespace zipkin {
+/**
+ * Abstract class for the wire formats spans are sent to Zipkin in.
+ *
+ * A list of spans is encoded by calling startList(), then addSpan() once per
+ * span, then endList(). Output is appended to the buffer passed to
+ * startList(), so that a caller can encode spans incrementally.
+ */
+class SpanEncoder {
+public:
+  /**
+   * Destructor.
+   */
+  virtual ~SpanEncoder() {}
+
+  /**
+   * @return the value of the Content-Type header for the encoded spans.
+   */
+  virtual const char *contentType() const = 0;
+
+  /**
+   * Starts a new list of spans.
+   *
+   * @param out The buffer the encoded spans are appended to.
+   */
+  virtual void startList(rapidjson::StringBuffer &out) = 0;
+
+  /**
+   * Appends the given span to the current list.
+   *
+   * @param span The span to encode.
+   */
+  virtual void addSpan(const Span &span) = 0;
+
+  /**
+   * Finishes the current list of spans.
+   */
+  virtual void endList() = 0;
+};
+
+typedef std::unique_ptr<SpanEncoder> SpanEncoderPtr;
+
+typedef rapidjson::Writer<rapidjson::StringBuffer> JsonWriter;
+
+/**
+ * Writes the given string as the key of a JSON object member.
+ */
+void writeKey(JsonWriter &writer, const std::string &key);
+
+/**
+ * Writes the given string as a JSON string.
+ */
+void writeString(JsonWriter &writer, const std::string &value);
+
+/**
+ * Writes the given ID as a JSON string of 16 hexadecimal digits.
+ */
+void writeHex(JsonWriter &writer, uint64_t value);
+
+/**
+ * Writes the given trace ID as a JSON string of 16 or 32 hexadecimal digits.
+ */
+void writeHex(JsonWriter &writer, const TraceId &value);
+
+/**
+ * Base class for the JSON formats, which encode a list of spans as a JSON
+ * array of span objects.
+ */
+class JsonSpanEncoder : public SpanEncoder {
+public:
+  /**
+   * Implementation of zipkin::SpanEncoder::contentType().
+   */
+  const char *contentType() const override { return "application/json"; }
+
+  /**
+   * Implementation of zipkin::SpanEncoder::startList().
+   */
+  void startList(rapidjson::StringBuffer &out) override;
+
+  /**
+   * Implementation of zipkin::SpanEncoder::addSpan().
+   */
+  void addSpan(const Span &span) override;
+
+  /**
+   * Implementation of zipkin::SpanEncoder::endList().
+   */
+  void endList() override;
+
+  /**
+   * Appends the given span as a standalone JSON object, outside of any list.
+   *
+   * @param out The buffer to append to.
+   * @param span The span to encode.
+   */
+  void encodeObject(rapidjson::StringBuffer &out, const Span &span);
+
+protected:
+  /**
+   * Writes the given span as a JSON object.
+   */
+  virtual void writeSpanObject(JsonWriter &writer, const Span &span) = 0;
+
+private:
+  rapidjson::StringBuffer *out_ = nullptr;
+  JsonWriter writer_;
+  bool is_first_span_ = true;
+};
+
+/**
+ * Estimates the size of a span once encoded. The estimate is made for the v1
+ * JSON format, which is the largest of the supported formats.
+ *
+ * @param span The span to estimate.
+ * @return the estimated size in bytes.
+ */
+size_t estimateEncodedSize(const Span &span);
+
+/**
+ * @return an encoder for the given format.
+ */
+SpanEncoderPtr makeSpanEncoder(SpanEncoding encoding);
+} // namespace zipkin
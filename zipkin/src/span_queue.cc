@@ -0,0 +1,167 @@
+#include "span_queue.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace zipkin {
+// Shards are not made smaller than this, so that a burst of spans from a
+// single thread does not need to spill over into other shards.
+static const size_t MIN_SHARD_CAPACITY = 32;
+
+SpanQueue::Shard::Shard(size_t capacity, size_t max_bytes)
+    : capacity{capacity}, high_water_mark{std::max<size_t>(capacity / 2, 1)},
+      max_bytes{max_bytes}, cells{new Cell[capacity]} {
+  for (size_t i = 0; i < capacity; ++i) {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool SpanQueue::Shard::reserveBytes(size_t size, bool &reached_high_water) {
+  auto previous = num_bytes.fetch_add(size, std::memory_order_relaxed);
+  // A span is accepted by an empty shard even if it is over budget, so that
+  // it can be reported at all.
+  if (previous > 0 && previous + size > max_bytes) {
+    num_bytes.fetch_sub(size, std::memory_order_relaxed);
+    return false;
+  }
+  reached_high_water = previous + size >= max_bytes / 2;
+  return true;
+}
+
+bool SpanQueue::Shard::push(Span &&span, size_t size,
+                            bool &reached_high_water) {
+  reached_high_water = false;
+  if (max_bytes > 0 && !reserveBytes(size, reached_high_water)) {
+    return false;
+  }
+  auto pos = enqueue_pos.load(std::memory_order_relaxed);
+  Cell *cell;
+  while (true) {
+    cell = &cells[pos % capacity];
+    auto sequence = cell->sequence.load(std::memory_order_acquire);
+    auto difference =
+        static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+    if (difference == 0) {
+      if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The cell still holds a span from the previous lap, so the shard is
+      // full.
+      if (max_bytes > 0) {
+        num_bytes.fetch_sub(size, std::memory_order_relaxed);
+      }
+      return false;
+    } else {
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->span = std::move(span);
+  cell->size = size;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+
+  auto num_spans = pos + 1 - dequeue_pos.load(std::memory_order_relaxed);
+  reached_high_water = reached_high_water || num_spans >= high_water_mark;
+  return true;
+}
+
+bool SpanQueue::Shard::pop(Span &span) {
+  auto pos = dequeue_pos.load(std::memory_order_relaxed);
+  Cell *cell;
+  while (true) {
+    cell = &cells[pos % capacity];
+    auto sequence = cell->sequence.load(std::memory_order_acquire);
+    auto difference =
+        static_cast<int64_t>(sequence) - static_cast<int64_t>(pos + 1);
+    if (difference == 0) {
+      if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // Either empty, or the producer that claimed the cell has not finished
+      // writing it yet.
+      return false;
+    } else {
+      pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  span = std::move(cell->span);
+  // Release the strings and vectors left behind by the move.
+  cell->span = Span{};
+  if (max_bytes > 0) {
+    num_bytes.fetch_sub(cell->size, std::memory_order_relaxed);
+  }
+  cell->sequence.store(pos + capacity, std::memory_order_release);
+  return true;
+}
+
+SpanQueue::SpanQueue(size_t max_spans, size_t max_bytes, size_t num_shards)
+    : has_memory_budget_{max_bytes > 0} {
+  max_spans = std::max<size_t>(max_spans, 1);
+  if (num_shards == 0) {
+    num_shards = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    num_shards = std::min(num_shards,
+                          std::max<size_t>(max_spans / MIN_SHARD_CAPACITY, 1));
+  }
+  auto shard_capacity = (max_spans + num_shards - 1) / num_shards;
+  auto shard_max_bytes = (max_bytes + num_shards - 1) / num_shards;
+  shards_.reserve(num_shards);
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new Shard{shard_capacity, shard_max_bytes});
+  }
+}
+
+size_t SpanQueue::shardIndex() const {
+  // Threads are assigned shards round-robin the first time they report a
+  // span.
+  static std::atomic<size_t> next_thread_index{0};
+  static thread_local size_t thread_index = next_thread_index++;
+  return thread_index % shards_.size();
+}
+
+bool SpanQueue::push(Span &&span, bool &reached_high_water) {
+  size_t size = has_memory_budget_ ? estimateMemorySize(span) : 0;
+  auto first = shardIndex();
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    auto &shard = *shards_[(first + i) % shards_.size()];
+    if (shard.push(std::move(span), size, reached_high_water)) {
+      return true;
+    }
+  }
+  reached_high_water = true;
+  return false;
+}
+
+bool SpanQueue::dropOldest() {
+  auto first = shardIndex();
+  Span span;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    if (shards_[(first + i) % shards_.size()]->pop(span)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t SpanQueue::drain(SpanBuffer &spans) {
+  size_t num_drained = 0;
+  Span span;
+  for (auto &shard : shards_) {
+    while (!spans.isFull() && shard->pop(span)) {
+      spans.addSpan(std::move(span));
+      ++num_drained;
+    }
+  }
+  return num_drained;
+}
+
+uint64_t SpanQueue::numPushed() const {
+  uint64_t result = 0;
+  for (auto &shard : shards_) {
+    result += shard->enqueue_pos.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+} // namespace zipkin
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "span_buffer.h"
+
+namespace zipkin {
+/**
+ * A bounded queue of finished spans that many threads can push to without
+ * taking a lock, and that a single thread drains. Pushing threads may also
+ * discard the oldest spans to make room.
+ *
+ * The queue is split into shards, each a fixed-size ring buffer (Dmitry
+ * Vyukov's bounded MPMC queue). Each thread pushes to its own shard, so that
+ * threads running on different CPUs rarely touch the same cache lines. If its
+ * shard is full, a thread tries the other shards before giving up.
+ *
+ * Besides the number of spans, the queue can bound the memory used by the
+ * spans it holds. The budget is split evenly between the shards.
+ */
+class SpanQueue {
+public:
+  /**
+   * Constructor.
+   *
+   * @param max_spans The number of spans the queue can hold.
+   * @param max_bytes The memory budget for the queued spans, as computed by
+   * estimateMemorySize(). If zero, the memory used is not limited.
+   * @param num_shards The number of shards. If zero, it is chosen from the
+   * number of CPUs and max_spans.
+   */
+  explicit SpanQueue(size_t max_spans, size_t max_bytes = 0,
+                     size_t num_shards = 0);
+
+  SpanQueue(const SpanQueue &) = delete;
+  SpanQueue &operator=(const SpanQueue &) = delete;
+
+  /**
+   * Moves a span into the queue. Can be called from any thread.
+   *
+   * @param span The span to add.
+   * @param reached_high_water Set to true if the shard the span was added to
+   * is at least half full, by count or by memory.
+   * @return true if the span was added, or false if the queue was full.
+   */
+  bool push(Span &&span, bool &reached_high_water);
+
+  /**
+   * Discards the oldest span of the calling thread's shard, or, if that shard
+   * is empty, of the first shard that is not. Can be called from any thread.
+   *
+   * @return true if a span was discarded, or false if the queue was empty.
+   */
+  bool dropOldest();
+
+  /**
+   * Moves queued spans into the given buffer until either the queue is empty
+   * or the buffer is full. Must only be called from one thread at a time.
+   *
+   * @param spans The buffer to add the spans to.
+   * @return the number of spans moved.
+   */
+  size_t drain(SpanBuffer &spans);
+
+  /**
+   * @return the number of spans that have ever been added to the queue.
+   */
+  uint64_t numPushed() const;
+
+  /**
+   * @return the number of shards.
+   */
+  size_t numShards() const { return shards_.size(); }
+
+private:
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  struct Cell {
+    std::atomic<uint64_t> sequence;
+    Span span;
+    size_t size;
+  };
+
+  struct Shard {
+    Shard(size_t capacity, size_t max_bytes);
+
+    // The producer and consumer positions are kept on separate cache lines.
+    std::atomic<uint64_t> enqueue_pos{0};
+    char enqueue_padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> dequeue_pos{0};
+    char dequeue_padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    // Only maintained if there is a memory budget.
+    std::atomic<size_t> num_bytes{0};
+    char num_bytes_padding[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+    const size_t capacity;
+    const size_t high_water_mark;
+    const size_t max_bytes;
+    std::unique_ptr<Cell[]> cells;
+
+    bool reserveBytes(size_t size, bool &reached_high_water);
+    bool push(Span &&span, size_t size, bool &reached_high_water);
+    bool pop(Span &span);
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  bool has_memory_budget_;
+
+  size_t shardIndex() const;
+};
+} // namespace zipkin
@@ -0,0 +1,245 @@
+#include "span_spool.h"
+
+#include <system_error>
+
+#ifdef _WIN32
+namespace zipkin {
+SpanSpool::SpanSpool(const std::string &directory, size_t max_bytes,
+                     uint32_t format) {
+  throw std::system_error{
+      std::make_error_code(std::errc::function_not_supported), directory};
+}
+
+SpanSpool::~SpanSpool() {}
+
+bool SpanSpool::append(const char *data, size_t size, uint32_t num_spans) {
+  return false;
+}
+
+bool SpanSpool::front(std::string &data, uint32_t &num_spans) {
+  return false;
+}
+
+void SpanSpool::pop() {}
+
+bool SpanSpool::empty() { return true; }
+} // namespace zipkin
+#else
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace zipkin {
+// Marks a segment file that was fully created.
+static const uint32_t SEGMENT_MAGIC = 0x7a6b5331;
+
+// Batches start on their own cache line after the segment header.
+static const size_t SEGMENT_DATA_OFFSET = 64;
+
+// Each batch is preceded by its size and its number of spans.
+static const size_t RECORD_HEADER_SIZE = 8;
+
+// The spool is split into about this many segments, so that space is
+// reclaimed as batches are replayed, but segments aren't tiny.
+static const size_t TARGET_NUM_SEGMENTS = 8;
+static const size_t MIN_SEGMENT_SIZE = 64 * 1024;
+
+static const char SEGMENT_SUFFIX[] = ".spool";
+
+static std::system_error makeSystemError(const std::string &what) {
+  return std::system_error{errno, std::system_category(), what};
+}
+
+SpanSpool::SpanSpool(const std::string &directory, size_t max_bytes,
+                     uint32_t format)
+    : directory_{directory}, format_{format} {
+  segment_size_ =
+      std::max(max_bytes / TARGET_NUM_SEGMENTS, MIN_SEGMENT_SIZE);
+  max_segments_ = std::max<size_t>(max_bytes / segment_size_, 1);
+
+  if (mkdir(directory_.c_str(), 0700) != 0 && errno != EEXIST) {
+    throw makeSystemError(directory_);
+  }
+  auto lock_path = directory_ + "/lock";
+  lock_file_ = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (lock_file_ < 0) {
+    throw makeSystemError(lock_path);
+  }
+  if (flock(lock_file_, LOCK_EX | LOCK_NB) != 0) {
+    auto error = makeSystemError(lock_path);
+    close(lock_file_);
+    throw error;
+  }
+
+  // Pick up the segments left by a previous process, oldest first.
+  std::vector<uint64_t> sequences;
+  if (auto dir = opendir(directory_.c_str())) {
+    while (auto entry = readdir(dir)) {
+      unsigned long long sequence;
+      char suffix[sizeof(SEGMENT_SUFFIX)] = {};
+      if (std::sscanf(entry->d_name, "%llu%6s", &sequence, suffix) == 2 &&
+          std::strcmp(suffix, SEGMENT_SUFFIX) == 0) {
+        sequences.push_back(sequence);
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(sequences.begin(), sequences.end());
+  try {
+    for (auto sequence : sequences) {
+      auto segment = mapSegment(sequence, false);
+      if (segment.header != nullptr) {
+        segments_.push_back(segment);
+      }
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+SpanSpool::~SpanSpool() { release(); }
+
+void SpanSpool::release() {
+  for (auto &segment : segments_) {
+    munmap(segment.header, segment_size_);
+  }
+  segments_.clear();
+  if (lock_file_ >= 0) {
+    close(lock_file_);
+    lock_file_ = -1;
+  }
+}
+
+std::string SpanSpool::segmentPath(uint64_t sequence) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llu",
+                static_cast<unsigned long long>(sequence));
+  return directory_ + '/' + name + SEGMENT_SUFFIX;
+}
+
+SpanSpool::Segment SpanSpool::mapSegment(uint64_t sequence, bool create) {
+  auto path = segmentPath(sequence);
+  auto file = open(path.c_str(),
+                   O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0600);
+  if (file < 0) {
+    throw makeSystemError(path);
+  }
+  struct stat file_status;
+  if ((create && ftruncate(file, static_cast<off_t>(segment_size_)) != 0) ||
+      fstat(file, &file_status) != 0) {
+    auto error = makeSystemError(path);
+    close(file);
+    throw error;
+  }
+  if (static_cast<size_t>(file_status.st_size) != segment_size_) {
+    // Left by a process with a different size limit, or never finished.
+    close(file);
+    unlink(path.c_str());
+    return Segment{sequence, nullptr};
+  }
+  auto mapping = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, file, 0);
+  close(file);
+  if (mapping == MAP_FAILED) {
+    throw makeSystemError(path);
+  }
+  auto header = static_cast<SegmentHeader *>(mapping);
+  if (create) {
+    header->write_offset = SEGMENT_DATA_OFFSET;
+    header->read_offset = SEGMENT_DATA_OFFSET;
+    header->format = format_;
+    header->magic = SEGMENT_MAGIC;
+  } else if (header->magic != SEGMENT_MAGIC || header->format != format_ ||
+             header->write_offset > segment_size_ ||
+             header->read_offset > header->write_offset) {
+    munmap(mapping, segment_size_);
+    unlink(path.c_str());
+    return Segment{sequence, nullptr};
+  }
+  return Segment{sequence, header};
+}
+
+void SpanSpool::removeOldestSegment() {
+  auto &segment = segments_.front();
+  munmap(segment.header, segment_size_);
+  unlink(segmentPath(segment.sequence).c_str());
+  segments_.pop_front();
+}
+
+bool SpanSpool::append(const char *data, size_t size, uint32_t num_spans) {
+  auto record_size = RECORD_HEADER_SIZE + size;
+  if (SEGMENT_DATA_OFFSET + record_size > segment_size_) {
+    return false;
+  }
+  if (segments_.empty() ||
+      segments_.back().header->write_offset + record_size > segment_size_) {
+    if (segments_.size() >= max_segments_) {
+      return false;
+    }
+    auto sequence = segments_.empty() ? 0 : segments_.back().sequence + 1;
+    segments_.push_back(mapSegment(sequence, true));
+  }
+  auto header = segments_.back().header;
+  auto record = reinterpret_cast<char *>(header) + header->write_offset;
+  uint32_t record_header[2] = {static_cast<uint32_t>(size), num_spans};
+  std::memcpy(record, record_header, RECORD_HEADER_SIZE);
+  std::memcpy(record + RECORD_HEADER_SIZE, data, size);
+  // The batch only becomes visible once it has been copied.
+  header->write_offset += record_size;
+  return true;
+}
+
+bool SpanSpool::empty() {
+  while (!segments_.empty()) {
+    auto header = segments_.front().header;
+    if (header->read_offset < header->write_offset) {
+      return false;
+    }
+    if (segments_.size() == 1) {
+      // Start the last segment over rather than removing it. If the process
+      // dies in between, the inconsistent offsets make the next process
+      // discard the segment, which is empty anyway.
+      header->write_offset = SEGMENT_DATA_OFFSET;
+      header->read_offset = SEGMENT_DATA_OFFSET;
+      return true;
+    }
+    removeOldestSegment();
+  }
+  return true;
+}
+
+bool SpanSpool::front(std::string &data, uint32_t &num_spans) {
+  if (empty()) {
+    return false;
+  }
+  auto header = segments_.front().header;
+  auto record = reinterpret_cast<const char *>(header) + header->read_offset;
+  uint32_t record_header[2];
+  std::memcpy(record_header, record, RECORD_HEADER_SIZE);
+  data.assign(record + RECORD_HEADER_SIZE, record_header[0]);
+  num_spans = record_header[1];
+  return true;
+}
+
+void SpanSpool::pop() {
+  if (empty()) {
+    return;
+  }
+  auto header = segments_.front().header;
+  uint32_t size;
+  std::memcpy(&size,
+              reinterpret_cast<const char *>(header) + header->read_offset,
+              sizeof(size));
+  header->read_offset += RECORD_HEADER_SIZE + size;
+}
+} // namespace zipkin
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace zipkin {
+/**
+ * A bounded queue of encoded batches of spans on disk, for batches that could
+ * not be sent to the collector and are to be sent again later.
+ *
+ * Batches are appended to fixed-size segment files in a directory, which are
+ * memory-mapped, so appending and reading are copies to and from the page
+ * cache. Segments are removed once all their batches have been read. Since
+ * the files are only written through the mappings, spooled batches survive
+ * the process exiting or crashing, and are picked up again when a spool is
+ * next opened on the directory.
+ *
+ * Each segment records the format its batches were written in, an opaque value
+ * given by the user of the spool, such as their encoding. Segments left in
+ * another format, for instance by a process configured differently, are
+ * discarded when the spool is opened.
+ *
+ * A lock file keeps other processes from using the same directory. The spool
+ * is not thread-safe.
+ */
+class SpanSpool {
+public:
+  /**
+   * Opens the spool in the given directory, creating the directory if
+   * needed.
+   *
+   * @param directory The directory holding the segment files.
+   * @param max_bytes The most disk space to use for segments.
+   * @param format The format of the batches appended.
+   *
+   * Throws std::system_error if the directory can't be created or locked, or
+   * an existing segment can't be mapped.
+   */
+  SpanSpool(const std::string &directory, size_t max_bytes,
+            uint32_t format = 0);
+
+  /**
+   * Destructor.
+   */
+  ~SpanSpool();
+
+  SpanSpool(const SpanSpool &) = delete;
+  SpanSpool &operator=(const SpanSpool &) = delete;
+
+  /**
+   * Appends a batch.
+   *
+   * @param data The encoded batch.
+   * @param size The size of the encoded batch.
+   * @param num_spans The number of spans in the batch.
+   * @return true if the batch was spooled, or false if the spool is full or
+   * the batch is larger than a segment.
+   */
+  bool append(const char *data, size_t size, uint32_t num_spans);
+
+  /**
+   * Reads the oldest batch without removing it.
+   *
+   * @param data Set to the encoded batch.
+   * @param num_spans Set to the number of spans in the batch.
+   * @return true if a batch was read, or false if the spool is empty.
+   */
+  bool front(std::string &data, uint32_t &num_spans);
+
+  /**
+   * Removes the oldest batch.
+   */
+  void pop();
+
+  /**
+   * @return true if no batches are spooled.
+   */
+  bool empty();
+
+private:
+  struct SegmentHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t write_offset;
+    uint64_t read_offset;
+  };
+
+  struct Segment {
+    uint64_t sequence;
+    SegmentHeader *header;
+  };
+
+  std::string directory_;
+  uint32_t format_;
+  size_t segment_size_;
+  size_t max_segments_;
+  int lock_file_ = -1;
+  std::deque<Segment> segments_;
+
+  void release();
+  std::string segmentPath(uint64_t sequence) const;
+  Segment mapSegment(uint64_t sequence, bool create);
+  void removeOldestSegment();
+};
+} // namespace zipkin
@@ -0,0 +1,216 @@
+#include "tail_sampling_reporter.h"
+
+#include "span_buffer.h"
+#include "zipkin_core_constants.h"
+
+#include <algorithm>
+
+namespace zipkin {
+static const uint64_t TRACE_ID_MASK = (1ULL << 63) - 1;
+
+// How often the decider thread looks for traces past their deadline, as a
+// fraction of the decision wait, and the bounds on it.
+static const int DECISION_CHECKS_PER_WAIT = 10;
+static const SteadyClock::duration MIN_DECISION_CHECK_PERIOD =
+    std::chrono::milliseconds{10};
+static const SteadyClock::duration MAX_DECISION_CHECK_PERIOD =
+    std::chrono::seconds{1};
+
+static bool isLocalRoot(const Span &span) {
+  if (!span.isSetParentId()) {
+    return true;
+  }
+  const auto &constants = ZipkinCoreConstants::get();
+  for (const auto &annotation : span.annotations()) {
+    if (annotation.value() == constants.SERVER_RECV) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TailSamplingReporter::TailSamplingReporter(ReporterPtr &&reporter,
+                                           const TailSamplingOptions &options)
+    : reporter_{std::move(reporter)}, decision_wait_{options.decision_wait},
+      latency_threshold_{options.latency_threshold.count()},
+      shard_max_bytes_{
+          std::max<size_t>(options.max_buffered_bytes / NUM_SHARDS, 1)} {
+  // Traces are kept at the base rate by comparing their IDs to a threshold,
+  // as the probabilistic sampler does, so that both agree on the same trace.
+  auto sample_rate = std::max(0.0, std::min(options.sample_rate, 1.0));
+  sample_threshold_ =
+      static_cast<uint64_t>(sample_rate * 9223372036854775808.0);
+  decider_ = std::thread(&TailSamplingReporter::decideTraces, this);
+}
+
+TailSamplingReporter::~TailSamplingReporter() {
+  {
+    std::lock_guard<std::mutex> lock{decider_mutex_};
+    decider_exit_ = true;
+  }
+  decider_cond_.notify_all();
+  decider_.join();
+  decideExpiredTraces(true);
+}
+
+void TailSamplingReporter::reportSpan(const Span &span) {
+  reportSpan(Span{span});
+}
+
+void TailSamplingReporter::reportSpan(Span &&span) {
+  auto trace_id = span.traceId();
+  auto size = estimateMemorySize(span);
+  auto is_interesting = isInteresting(span);
+  auto is_local_root = isLocalRoot(span);
+  auto &shard = shards_[TraceIdHash{}(trace_id) % NUM_SHARDS];
+  std::vector<Trace> decided_traces;
+  bool is_late = false;
+  bool is_late_kept = false;
+  {
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    auto iter = shard.traces.find(trace_id);
+    if (iter == shard.traces.end()) {
+      auto now = SteadyClock::now();
+      expireDecisions(shard, now);
+      // A span of a trace decided within the decision wait follows the
+      // decision, instead of starting a new trace.
+      auto decision = shard.decisions.find(trace_id);
+      if (decision != shard.decisions.end()) {
+        is_late = true;
+        is_late_kept = decision->second;
+      } else {
+        iter = shard.traces.emplace(trace_id, Trace{}).first;
+        auto &trace = iter->second;
+        trace.deadline = now + decision_wait_;
+        trace.position = shard.order.insert(shard.order.end(), trace_id);
+      }
+    }
+    if (!is_late) {
+      auto &trace = iter->second;
+      trace.spans.push_back(std::move(span));
+      trace.memory_size += size;
+      trace.is_interesting = trace.is_interesting || is_interesting;
+      shard.memory_size += size;
+      if (is_local_root) {
+        takeTrace(shard, trace_id, decided_traces);
+      }
+      while (shard.memory_size > shard_max_bytes_ && !shard.order.empty()) {
+        takeTrace(shard, shard.order.front(), decided_traces);
+        ++num_traces_evicted_;
+      }
+    }
+  }
+  if (is_late_kept) {
+    reporter_->reportSpan(std::move(span));
+  }
+  forward(decided_traces);
+}
+
+bool TailSamplingReporter::flushWithTimeout(
+    std::chrono::system_clock::duration timeout) {
+  decideExpiredTraces(true);
+  return reporter_->flushWithTimeout(timeout);
+}
+
+ReporterStats TailSamplingReporter::stats() const {
+  auto result = reporter_->stats();
+  result.traces_kept = num_traces_kept_;
+  result.traces_discarded = num_traces_discarded_;
+  result.traces_evicted = num_traces_evicted_;
+  return result;
+}
+
+bool TailSamplingReporter::isInteresting(const Span &span) const {
+  if (latency_threshold_ > 0 && span.isSetDuration() &&
+      span.duration() >= latency_threshold_) {
+    return true;
+  }
+  for (const auto &annotation : span.binaryAnnotations()) {
+    if (annotation.key() != "error") {
+      continue;
+    }
+    // An error tag set to false is not an error.
+    if (annotation.annotationType() != BOOL || annotation.valueBool()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TailSamplingReporter::expireDecisions(Shard &shard, SteadyTime now) {
+  while (!shard.decision_order.empty() &&
+         (shard.decision_order.front().expiry <= now ||
+          shard.decision_order.size() > MAX_DECISIONS_PER_SHARD)) {
+    shard.decisions.erase(shard.decision_order.front().trace_id);
+    shard.decision_order.pop_front();
+  }
+}
+
+void TailSamplingReporter::takeTrace(Shard &shard, TraceId trace_id,
+                                     std::vector<Trace> &decided_traces) {
+  auto iter = shard.traces.find(trace_id);
+  auto &trace = iter->second;
+  shard.memory_size -= trace.memory_size;
+  shard.order.erase(trace.position);
+  auto is_kept = trace.is_interesting ||
+                 (trace_id.low() & TRACE_ID_MASK) < sample_threshold_;
+  if (is_kept) {
+    ++num_traces_kept_;
+    decided_traces.push_back(std::move(trace));
+  } else {
+    ++num_traces_discarded_;
+  }
+  shard.traces.erase(iter);
+  auto now = SteadyClock::now();
+  shard.decisions[trace_id] = is_kept;
+  shard.decision_order.push_back(Decision{trace_id, now + decision_wait_});
+  expireDecisions(shard, now);
+}
+
+void TailSamplingReporter::forward(std::vector<Trace> &decided_traces) {
+  for (auto &trace : decided_traces) {
+    for (auto &span : trace.spans) {
+      reporter_->reportSpan(std::move(span));
+    }
+  }
+  decided_traces.clear();
+}
+
+void TailSamplingReporter::decideExpiredTraces(bool decide_all) {
+  std::vector<Trace> decided_traces;
+  for (auto &shard : shards_) {
+    {
+      std::lock_guard<std::mutex> lock{shard.mutex};
+      auto now = SteadyClock::now();
+      while (!shard.order.empty()) {
+        const auto &trace_id = shard.order.front();
+        if (!decide_all &&
+            shard.traces.find(trace_id)->second.deadline > now) {
+          break;
+        }
+        takeTrace(shard, trace_id, decided_traces);
+      }
+    }
+    forward(decided_traces);
+  }
+}
+
+void TailSamplingReporter::decideTraces() {
+  auto check_period = std::min(
+      std::max(decision_wait_ / DECISION_CHECKS_PER_WAIT,
+               MIN_DECISION_CHECK_PERIOD),
+      MAX_DECISION_CHECK_PERIOD);
+  std::unique_lock<std::mutex> lock{decider_mutex_};
+  while (!decider_cond_.wait_for(lock, check_period,
+                                 [this] { return this->decider_exit_; })) {
+    lock.unlock();
+    decideExpiredTraces(false);
+    lock.lock();
+  }
+}
+
+ReporterPtr makeTailSamplingReporter(ReporterPtr &&reporter,
+                                     const TailSamplingOptions &options) {
+  return ReporterPtr{new TailSamplingReporter{std::move(reporter), options}};
+}
+} // namespace zipkin
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <zipkin/tracer.h>
+
+namespace zipkin {
+/**
+ * This class derives from the abstract zipkin::Reporter. It holds finished
+ * spans grouped by trace ID, and forwards whole traces chosen by the rules of
+ * its TailSamplingOptions to another reporter, typically a ReporterImpl.
+ *
+ * A trace is decided when its local root span finishes: a span without a
+ * parent, or a server span, which starts the trace in this process. A thread
+ * decides the traces whose root has not finished within the decision wait,
+ * for instance because it finished in another process. Spans that finish
+ * within the decision wait after their trace was decided follow the decision:
+ * they are forwarded if it was kept and discarded otherwise. Later spans start
+ * a new trace, decided on its own.
+ *
+ * Traces are split between shards by trace ID, each with its own lock, list of
+ * traces in order of arrival, recent decisions and share of the memory budget.
+ * A shard over budget decides its oldest traces early.
+ */
+class TailSamplingReporter : public Reporter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param reporter The reporter to forward kept traces to.
+   * @param options The options that control which traces are kept.
+   */
+  TailSamplingReporter(ReporterPtr &&reporter,
+                       const TailSamplingOptions &options);
+
+  /**
+   * Destructor. Decides the traces still held, and forwards those kept.
+   */
+  ~TailSamplingReporter();
+
+  /**
+   * Implementation of zipkin::Reporter::reportSpan().
+   */
+  void reportSpan(const Span &span) override;
+
+  /**
+   * Implementation of zipkin::Reporter::reportSpan().
+   *
+   * Adds the span to its trace, and decides the trace if the span is its
+   * local root.
+   *
+   * @param span The span to be held.
+   */
+  void reportSpan(Span &&span) override;
+
+  /**
+   * Implementation of zipkin::Reporter::flushWithTimeout().
+   *
+   * Decides every trace held, without waiting for its root span, and flushes
+   * the reporter the kept traces are forwarded to.
+   */
+  bool flushWithTimeout(std::chrono::system_clock::duration timeout) override;
+
+  /**
+   * Implementation of zipkin::Reporter::stats().
+   *
+   * @return the counters of the reporter kept traces are forwarded to, with
+   * the trace counters of this one.
+   */
+  ReporterStats stats() const override;
+
+private:
+  struct TraceIdHash {
+    size_t operator()(const TraceId &trace_id) const {
+      return static_cast<size_t>(trace_id.low() ^ trace_id.high());
+    }
+  };
+
+  struct Trace {
+    std::vector<Span> spans;
+    size_t memory_size = 0;
+    SteadyTime deadline;
+    bool is_interesting = false;
+    std::list<TraceId>::iterator position;
+  };
+
+  struct Decision {
+    TraceId trace_id;
+    SteadyTime expiry;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<TraceId, Trace, TraceIdHash> traces;
+    // Trace IDs in order of arrival, which is also the order of deadlines.
+    std::list<TraceId> order;
+    size_t memory_size = 0;
+    // Whether recently decided traces were kept, and the decisions in the
+    // order they were made, which is also the order of expiry.
+    std::unordered_map<TraceId, bool, TraceIdHash> decisions;
+    std::deque<Decision> decision_order;
+  };
+
+  static const size_t NUM_SHARDS = 16;
+  static const size_t MAX_DECISIONS_PER_SHARD = 4096;
+
+  ReporterPtr reporter_;
+  SteadyClock::duration decision_wait_;
+  int64_t latency_threshold_;
+  uint64_t sample_threshold_;
+  size_t shard_max_bytes_;
+  Shard shards_[NUM_SHARDS];
+
+  std::atomic<uint64_t> num_traces_kept_{0};
+  std::atomic<uint64_t> num_traces_discarded_{0};
+  std::atomic<uint64_t> num_traces_evicted_{0};
+
+  std::mutex decider_mutex_;
+  std::condition_variable decider_cond_;
+  bool decider_exit_ = false;
+  std::thread decider_;
+
+  bool isInteresting(const Span &span) const;
+  void expireDecisions(Shard &shard, SteadyTime now);
+  void takeTrace(Shard &shard, TraceId trace_id,
+                 std::vector<Trace> &decided_traces);
+  void forward(std::vector<Trace> &decided_traces);
+  void decideExpiredTraces(bool decide_all);
+  void decideTraces();
+};
+} // namespace zipkin
@@ -2,7 +2,18 @@
 
 #include "span_buffer.h"
 
+#include <functional>
+
 namespace zipkin {
+/**
+ * Callback invoked by an asynchronous Transporter each time it is done with a
+ * batch, with the number of its spans that were sent and the number that were
+ * not. Spans set aside to be sent later, such as spooled ones, count as not
+ * sent.
+ */
+typedef std::function<void(size_t num_spans_sent, size_t num_spans_dropped)>
+    TransportCallback;
+
 /**
  * Abstract class that delegates to users of the Tracer class the responsibility
  * of "transporting" Zipkin spans that have ended its life cycle.
@@ -18,9 +29,55 @@ public:
    * Method that a concrete Transporter class must implement to handle finished
    * spans.
    *
+   * A transporter may take the spans by swapping them out of the given buffer,
+   * leaving it empty and possibly with a different capacity.
+   *
    * @param spans The SpanBuffer that needs action.
    */
   virtual void transportSpans(SpanBuffer &spans) = 0;
+
+  /**
+   * Optional method that a Transporter which sends spans asynchronously must
+   * implement. Such a transporter may return from transportSpans() before the
+   * spans are sent; it then calls the given callback once it is done with
+   * them, whether or not they could be sent.
+   *
+   * @param callback The callback to call when a batch has been sent.
+   * @return true if the transporter sends spans asynchronously and will call
+   * the callback, or false if spans are sent by the time transportSpans()
+   * returns.
+   */
+  virtual bool setCompletionCallback(TransportCallback callback) {
+    return false;
+  }
+
+  /**
+   * Optional method that a Transporter which sends spans asynchronously can
+   * implement to wait for the batches passed to transportSpans() to be sent.
+   *
+   * @param deadline The time to stop waiting at.
+   */
+  virtual void flush(SteadyTime deadline) {}
+
+  /**
+   * Optional method that a Transporter whose transportSpans() can block, for
+   * instance waiting for room to send a batch, can implement to stop waiting
+   * at the given time. Can be called from any thread, including while another
+   * thread is blocked in transportSpans().
+   *
+   * @param deadline The time after which transportSpans() drops the spans
+   * given to it rather than wait any longer.
+   */
+  virtual void setDeadline(SteadyTime deadline) {}
+
+  /**
+   * Optional method that a Transporter which discards some of the spans given
+   * to it, instead of sending them, can implement to report how many it has
+   * discarded. Can be called from any thread.
+   *
+   * @return the number of spans discarded.
+   */
+  virtual uint64_t numSpansDropped() const { return 0; }
 };
 
 typedef std::unique_ptr<Transporter> TransporterPtr;
@@ -0,0 +1,102 @@
+#include "v2_span_view.h"
+
+#include "zipkin_core_constants.h"
+
+#include <zipkin/rapidjson/internal/dtoa.h>
+#include <zipkin/rapidjson/internal/itoa.h>
+
+namespace zipkin {
+V2SpanView::V2SpanView(const Span &span) {
+  const auto &constants = ZipkinCoreConstants::get();
+  const Endpoint *first_endpoint = nullptr;
+  for (const auto &annotation : span.annotations()) {
+    const Endpoint *endpoint =
+        annotation.isSetEndpoint() ? &annotation.endpoint() : nullptr;
+    if (first_endpoint == nullptr) {
+      first_endpoint = endpoint;
+    }
+    if (kind_ != SpanKind::UNSPECIFIED) {
+      continue;
+    }
+    const auto &value = annotation.value();
+    if (value == constants.CLIENT_SEND || value == constants.CLIENT_RECV) {
+      kind_ = SpanKind::CLIENT;
+      local_endpoint_ = endpoint;
+    } else if (value == constants.SERVER_RECV ||
+               value == constants.SERVER_SEND) {
+      kind_ = SpanKind::SERVER;
+      local_endpoint_ = endpoint;
+    }
+  }
+
+  const Endpoint *local_component_endpoint = nullptr;
+  for (const auto &annotation : span.binaryAnnotations()) {
+    if (!annotation.isSetEndpoint()) {
+      continue;
+    }
+    const auto &key = annotation.key();
+    if (key == constants.LOCAL_COMPONENT) {
+      local_component_endpoint = &annotation.endpoint();
+    } else if (key == constants.CLIENT_ADDR || key == constants.SERVER_ADDR) {
+      remote_endpoint_ = &annotation.endpoint();
+    } else if (first_endpoint == nullptr) {
+      first_endpoint = &annotation.endpoint();
+    }
+  }
+
+  if (local_endpoint_ == nullptr) {
+    local_endpoint_ = local_component_endpoint != nullptr
+                          ? local_component_endpoint
+                          : first_endpoint;
+  }
+}
+
+bool V2SpanView::isCoreAnnotation(const Annotation &annotation) {
+  const auto &constants = ZipkinCoreConstants::get();
+  const auto &value = annotation.value();
+  return value == constants.CLIENT_SEND || value == constants.CLIENT_RECV ||
+         value == constants.SERVER_RECV || value == constants.SERVER_SEND;
+}
+
+bool V2SpanView::isTag(const BinaryAnnotation &annotation) {
+  const auto &constants = ZipkinCoreConstants::get();
+  const auto &key = annotation.key();
+  return key != constants.LOCAL_COMPONENT && key != constants.CLIENT_ADDR &&
+         key != constants.SERVER_ADDR;
+}
+
+const char *V2SpanView::tagValue(const BinaryAnnotation &annotation,
+                                 char (&buffer)[32], size_t &size) {
+  char *end = buffer;
+  switch (annotation.annotationType()) {
+  case STRING:
+    size = annotation.valueString().size();
+    return annotation.valueString().data();
+  case BOOL:
+    size = annotation.valueBool() ? 4 : 5;
+    return annotation.valueBool() ? "true" : "false";
+  case INT64:
+    end = rapidjson::internal::i64toa(annotation.valueInt64(), buffer);
+    break;
+  case DOUBLE:
+    end = rapidjson::internal::dtoa(annotation.valueDouble(), buffer);
+    break;
+  }
+  size = static_cast<size_t>(end - buffer);
+  return buffer;
+}
+
+const char *V2SpanView::host(const IpAddress &address, size_t &size) {
+  const auto &friendly_address = address.addressAsString();
+  const char *data = friendly_address.data();
+  if (address.version() == IpVersion::v6 && !friendly_address.empty() &&
+      friendly_address[0] == '[') {
+    auto end = friendly_address.find(']');
+    size = end == std::string::npos ? friendly_address.size() - 1 : end - 1;
+    return data + 1;
+  }
+  auto end = friendly_address.rfind(':');
+  size = end == std::string::npos ? friendly_address.size() : end;
+  return data;
+}
+} // namespace zipkin
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <zipkin/zipkin_core_types.h>
+
+namespace zipkin {
+/**
+ * Values of the Zipkin v2 span kind. The numbering follows zipkin.proto3.
+ */
+enum class SpanKind { UNSPECIFIED = 0, CLIENT = 1, SERVER = 2 };
+
+/**
+ * Interprets a span recorded in the v1 model (annotations with endpoints)
+ * the way the Zipkin v2 model represents it.
+ *
+ * The cs/cr and sr/ss annotations become the span kind, the endpoint they
+ * share becomes the single local endpoint, and the "ca"/"sa" binary
+ * annotations become the remote endpoint. The view is computed in a single
+ * pass over the span and does not allocate.
+ */
+class V2SpanView {
+public:
+  /**
+   * Constructor.
+   *
+   * @param span The span to interpret. It must outlive the view.
+   */
+  explicit V2SpanView(const Span &span);
+
+  /**
+   * @return the span kind.
+   */
+  SpanKind kind() const { return kind_; }
+
+  /**
+   * @return the local endpoint, or nullptr if the span records none.
+   */
+  const Endpoint *localEndpoint() const { return local_endpoint_; }
+
+  /**
+   * @return the remote endpoint, or nullptr if the span records none.
+   */
+  const Endpoint *remoteEndpoint() const { return remote_endpoint_; }
+
+  /**
+   * @return true if the annotation is one of cs, cr, sr or ss. These are
+   * represented by the span kind, timestamp and duration in the v2 model.
+   */
+  static bool isCoreAnnotation(const Annotation &annotation);
+
+  /**
+   * @return true if the binary annotation is a v2 tag, i.e. not one of the
+   * "lc", "ca" or "sa" annotations used to carry endpoints.
+   */
+  static bool isTag(const BinaryAnnotation &annotation);
+
+  /**
+   * Formats the value of a binary annotation as a v2 tag value, which is
+   * always a string. Non-string values are formatted the way the JSON writer
+   * would format them.
+   *
+   * @param annotation The binary annotation to format.
+   * @param buffer Scratch space used for non-string values.
+   * @param size Set to the length of the value.
+   * @return a pointer to the first character of the value.
+   */
+  static const char *tagValue(const BinaryAnnotation &annotation,
+                              char (&buffer)[32], size_t &size);
+
+  /**
+   * Extracts the host part of an address, without the port that
+   * IpAddress::addressAsString() includes.
+   *
+   * @param address The address to inspect.
+   * @param size Set to the length of the host.
+   * @return a pointer to the first character of the host.
+   */
+  static const char *host(const IpAddress &address, size_t &size);
+
+private:
+  SpanKind kind_ = SpanKind::UNSPECIFIED;
+  const Endpoint *local_endpoint_ = nullptr;
+  const Endpoint *remote_endpoint_ = nullptr;
+};
+} // namespace zipkin
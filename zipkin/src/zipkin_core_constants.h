@@ -36,6 +36,7 @@ public:
   const std::string ALWAYS_SAMPLE = "1";
 
   const std::string DEFAULT_COLLECTOR_ENDPOINT = "/api/v1/spans";
+  const std::string DEFAULT_COLLECTOR_V2_ENDPOINT = "/api/v2/spans";
 };
 
 typedef ConstSingleton<ZipkinCoreConstantValues> ZipkinCoreConstants;
@@ -0,0 +1,188 @@
+#include "zipkin_file_transporter.h"
+
+#include "json_v1_encoder.h"
+#include "json_v2_encoder.h"
+#include "zipkin_reporter_impl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zipkin {
+static void syncData(int file) {
+#ifdef __linux__
+  // The file's metadata, other than its size, need not be written.
+  fdatasync(file);
+#else
+  fsync(file);
+#endif
+}
+
+ZipkinFileTransporter::ZipkinFileTransporter(
+    const FileTransportOptions &options)
+    : options_(options) {
+  if (options_.path.empty()) {
+    throw std::invalid_argument{"no path given for the span file"};
+  }
+  switch (options_.encoding) {
+  case SpanEncoding::JSON_V1:
+    encoder_.reset(new JsonV1Encoder{});
+    break;
+  case SpanEncoding::JSON_V2:
+    encoder_.reset(new JsonV2Encoder{});
+    break;
+  case SpanEncoding::PROTO3:
+    throw std::invalid_argument{
+        "spans can only be written to a file in a JSON encoding"};
+  }
+}
+
+ZipkinFileTransporter::~ZipkinFileTransporter() { closeFile(); }
+
+bool ZipkinFileTransporter::openFile() {
+  file_ = open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+               0644);
+  if (file_ < 0) {
+    std::cerr << options_.path << ": " << std::strerror(errno) << '\n';
+    return false;
+  }
+  struct stat file_status;
+  file_size_ = fstat(file_, &file_status) == 0
+                   ? static_cast<size_t>(file_status.st_size)
+                   : 0;
+  file_open_time_ = SteadyClock::now();
+  return true;
+}
+
+void ZipkinFileTransporter::closeFile() {
+  if (file_ < 0) {
+    return;
+  }
+  if (options_.fsync_policy == FsyncPolicy::ON_ROTATE) {
+    syncData(file_);
+  }
+  close(file_);
+  file_ = -1;
+}
+
+bool ZipkinFileTransporter::shouldRotate(size_t batch_size) const {
+  if (file_size_ == 0) {
+    return false;
+  }
+  if (options_.max_file_size > 0 &&
+      file_size_ + batch_size > options_.max_file_size) {
+    return true;
+  }
+  return options_.max_file_age.count() > 0 &&
+         SteadyClock::now() - file_open_time_ >= options_.max_file_age;
+}
+
+void ZipkinFileTransporter::rotate() {
+  closeFile();
+  const auto &path = options_.path;
+  if (options_.max_rotated_files == 0) {
+    unlink(path.c_str());
+    return;
+  }
+  // Renaming over the oldest file removes it. Missing files are skipped.
+  for (auto i = options_.max_rotated_files - 1; i > 0; --i) {
+    std::rename((path + '.' + std::to_string(i)).c_str(),
+                (path + '.' + std::to_string(i + 1)).c_str());
+  }
+  std::rename(path.c_str(), (path + ".1").c_str());
+  has_partial_line_ = false;
+}
+
+bool ZipkinFileTransporter::writeBody(size_t &num_lines_written) {
+  num_lines_written = 0;
+  if (has_partial_line_) {
+    if (write(file_, "\n", 1) != 1) {
+      std::cerr << options_.path << ": " << std::strerror(errno) << '\n';
+      return false;
+    }
+    ++file_size_;
+    has_partial_line_ = false;
+  }
+  auto data = body_.GetString();
+  auto size = body_.GetSize();
+  auto start_size = file_size_;
+  struct stat file_status;
+  if (fstat(file_, &file_status) == 0) {
+    start_size = static_cast<size_t>(file_status.st_size);
+  }
+  while (size > 0) {
+    auto result = write(file_, data, size);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << options_.path << ": " << std::strerror(errno) << '\n';
+      // Remove what was written of the batch, so that the file doesn't end
+      // in part of a line. If that fails, the next batch ends the partial
+      // line first.
+      if (ftruncate(file_, static_cast<off_t>(start_size)) == 0) {
+        file_size_ = start_size;
+      } else {
+        num_lines_written = static_cast<size_t>(
+            std::count(body_.GetString(), data, '\n'));
+        has_partial_line_ = data != body_.GetString() && data[-1] != '\n';
+      }
+      return false;
+    }
+    data += result;
+    size -= static_cast<size_t>(result);
+    file_size_ += static_cast<size_t>(result);
+  }
+  if (options_.fsync_policy == FsyncPolicy::EVERY_BATCH) {
+    syncData(file_);
+  }
+  return true;
+}
+
+void ZipkinFileTransporter::transportSpans(SpanBuffer &spans) {
+  if (spans.pendingSpans() == 0) {
+    return;
+  }
+  try {
+    body_.Clear();
+    for (size_t i = 0; i < spans.pendingSpans(); ++i) {
+      encoder_->encodeObject(body_, spans.span(i));
+      body_.Put('\n');
+    }
+  } catch (const std::bad_alloc &) {
+    // Drop spans
+    num_spans_dropped_ += spans.pendingSpans();
+    return;
+  }
+
+  if (file_ >= 0 && shouldRotate(body_.GetSize())) {
+    rotate();
+  }
+  size_t num_lines_written = 0;
+  if ((file_ < 0 && !openFile()) || !writeBody(num_lines_written)) {
+    // Lines are only left behind if the partial line couldn't be removed.
+    num_spans_dropped_ += spans.pendingSpans() - num_lines_written;
+    // Reopen the file for the next batch, in case it was removed or the
+    // file system was remounted.
+    closeFile();
+  }
+}
+
+ReporterPtr makeFileReporter(const FileTransportOptions &transport_options,
+                             const ReporterOptions &reporter_options) try {
+  std::unique_ptr<Transporter> transporter{
+      new ZipkinFileTransporter{transport_options}};
+  std::unique_ptr<Reporter> reporter{
+      new ReporterImpl{std::move(transporter), reporter_options}};
+  return reporter;
+} catch (const std::invalid_argument &error) {
+  std::cerr << error.what() << '\n';
+  return nullptr;
+}
+} // namespace zipkin
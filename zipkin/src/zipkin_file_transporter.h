@@ -0,0 +1,72 @@
+#pragma once
+
+#include "span_encoder.h"
+#include "transporter.h"
+
+#include <atomic>
+#include <string>
+
+namespace zipkin {
+/**
+ * This class derives from the abstract zipkin::Transporter. It appends spans
+ * to a file as newline-delimited JSON, one span per line, for an agent that
+ * tails the file to ship them.
+ *
+ * The file is opened with O_APPEND and each batch is written with a single
+ * write() call, so lines from a batch are never interleaved with other
+ * writers' lines. Before a batch would take the file over max_file_size, or
+ * once the file is older than max_file_age, the file is rotated the way
+ * logrotate does it: path becomes path.1, path.1 becomes path.2, and so on,
+ * up to max_rotated_files.
+ *
+ * A batch that can't be written is dropped, and counted by numSpansDropped().
+ */
+class ZipkinFileTransporter : public Transporter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param options The options that control how spans are written.
+   *
+   * Throws std::invalid_argument if the path is empty or the encoding is not
+   * a JSON one.
+   */
+  explicit ZipkinFileTransporter(const FileTransportOptions &options);
+
+  /**
+   * Destructor.
+   */
+  ~ZipkinFileTransporter();
+
+  /**
+   * Implementation of zipkin::Transporter::transportSpans().
+   *
+   * @param spans The spans to be transported.
+   */
+  void transportSpans(SpanBuffer &spans) override;
+
+  /**
+   * Implementation of zipkin::Transporter::numSpansDropped().
+   */
+  uint64_t numSpansDropped() const override { return num_spans_dropped_; }
+
+private:
+  FileTransportOptions options_;
+  std::unique_ptr<JsonSpanEncoder> encoder_;
+  // Kept across batches, so that once it has grown to the size of a typical
+  // batch, encoding does not allocate.
+  rapidjson::StringBuffer body_;
+  int file_ = -1;
+  size_t file_size_ = 0;
+  // Set when a failed write left part of a line at the end of the file.
+  bool has_partial_line_ = false;
+  SteadyTime file_open_time_;
+  std::atomic<uint64_t> num_spans_dropped_{0};
+
+  bool openFile();
+  void closeFile();
+  bool shouldRotate(size_t batch_size) const;
+  void rotate();
+  bool writeBody(size_t &num_lines_written);
+};
+} // namespace zipkin
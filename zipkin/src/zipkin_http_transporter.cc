@@ -1,71 +1,949 @@
 #include "zipkin_http_transporter.h"
 
+#include "gzip_span_encoder.h"
+#include "span_spool.h"
 #include "zipkin_core_constants.h"
 #include "zipkin_reporter_impl.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <curl/curl.h>
 #include <iostream>
+#include <system_error>
 
 namespace zipkin {
-static std::string getUrl(const char *collector_host, uint32_t collector_port) {
+// The delay before spooled batches are sent again after a failure. It is
+// doubled after each failure, up to the maximum.
+static const SteadyClock::duration MIN_REPLAY_BACKOFF = std::chrono::seconds{1};
+static const SteadyClock::duration MAX_REPLAY_BACKOFF =
+    std::chrono::seconds{60};
+
+// Upper bounds on the delay before a retry, and on the delay a collector can
+// ask for with Retry-After.
+static const SteadyClock::duration MAX_RETRY_DELAY = std::chrono::seconds{30};
+static const std::chrono::seconds MAX_RETRY_AFTER{300};
+
+// How long a batch waits for a free request before it is dropped. Requests
+// waiting to be retried keep their batch, so without a bound the thread
+// calling transportSpans() could wait for as long as a retry delay.
+static const SteadyClock::duration MAX_REQUEST_WAIT = std::chrono::seconds{5};
+
+// Parses the value of a Retry-After header, which is either a number of
+// seconds or an HTTP date.
+static SteadyClock::duration parseRetryAfter(const char *data, size_t size) {
+  std::string value{data, size};
+  auto first = value.find_first_not_of(" \t");
+  auto last = value.find_last_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    return SteadyClock::duration::zero();
+  }
+  value = value.substr(first, last - first + 1);
+  long long seconds;
+  if (std::all_of(value.begin(), value.end(),
+                  [](char c) { return std::isdigit(c) != 0; })) {
+    seconds = std::strtoll(value.c_str(), nullptr, 10);
+  } else {
+    auto time = curl_getdate(value.c_str(), nullptr);
+    if (time < 0) {
+      return SteadyClock::duration::zero();
+    }
+    seconds = static_cast<long long>(time - std::time(nullptr));
+  }
+  if (seconds <= 0) {
+    return SteadyClock::duration::zero();
+  }
+  return std::chrono::seconds{std::min<long long>(seconds,
+                                                  MAX_RETRY_AFTER.count())};
+}
+
+static bool hasHeaderName(const char *data, size_t size, const char *name) {
+  auto name_size = std::strlen(name);
+  if (size <= name_size || data[name_size] != ':') {
+    return false;
+  }
+  for (size_t i = 0; i < name_size; ++i) {
+    if (std::tolower(static_cast<unsigned char>(data[i])) != name[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A collector fails this many requests in a row before it is ejected.
+static const int MAX_CONSECUTIVE_FAILURES = 3;
+
+static const std::string &getEndpointPath(SpanEncoding encoding) {
+  return encoding == SpanEncoding::JSON_V1
+             ? ZipkinCoreConstants::get().DEFAULT_COLLECTOR_ENDPOINT
+             : ZipkinCoreConstants::get().DEFAULT_COLLECTOR_V2_ENDPOINT;
+}
+
+static std::string getUrl(const char *collector_host, uint32_t collector_port,
+                          SpanEncoding encoding) {
   return std::string{"http://"} + collector_host + ":" +
-         std::to_string(collector_port) +
-         ZipkinCoreConstants::get().DEFAULT_COLLECTOR_ENDPOINT;
+         std::to_string(collector_port) + getEndpointPath(encoding);
+}
+
+static std::string getUrl(const std::string &collector_url,
+                          SpanEncoding encoding) {
+  auto host_start = collector_url.find("://");
+  host_start = host_start == std::string::npos ? 0 : host_start + 3;
+  auto path_start = collector_url.find('/', host_start);
+  if (path_start != std::string::npos &&
+      path_start + 1 < collector_url.size()) {
+    return collector_url;
+  }
+  return collector_url.substr(0, path_start) + getEndpointPath(encoding);
+}
+
+// Maps a trace ID to one of num_routes routes. Trace IDs are usually random,
+// but are mixed anyway in case they are not.
+static size_t routeTraceId(const TraceId &trace_id, size_t num_routes) {
+  auto hash = trace_id.low() ^ (trace_id.high() * 0x9e3779b97f4a7c15ULL);
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return static_cast<size_t>(hash % num_routes);
+}
+
+static HttpTransportOptions
+makeHttpTransportOptions(const char *collector_host, uint32_t collector_port,
+                         std::chrono::milliseconds collector_timeout,
+                         SpanEncoding encoding) {
+  HttpTransportOptions options;
+  options.collector_host = collector_host;
+  options.collector_port = collector_port;
+  options.collector_timeout = collector_timeout;
+  options.encoding = encoding;
+  return options;
+}
+
+// Identifies how spooled batches are encoded, so that batches spooled by a
+// process configured differently aren't sent with the wrong headers. Zero is
+// left unused, as it is the format of segments from before it was recorded.
+static uint32_t getSpoolFormat(const HttpTransportOptions &options) {
+  auto format = static_cast<uint32_t>(options.encoding) + 1;
+  if (options.compression_level > 0) {
+    format |= 0x100;
+  }
+  return format;
+}
+
+static SpanEncoderPtr makeRequestEncoder(const HttpTransportOptions &options) {
+  auto encoder = makeSpanEncoder(options.encoding);
+  if (options.compression_level > 0) {
+    encoder.reset(
+        new GzipSpanEncoder{std::move(encoder),
+                            std::min(options.compression_level, 9)});
+  }
+  return encoder;
 }
 
-ZipkinHttpTransporter::ZipkinHttpTransporter(const char *collector_host,
-                                             uint32_t collector_port,
-                                             std::chrono::milliseconds collector_timeout) {
-  auto rcode = curl_easy_setopt(handle_, CURLOPT_URL,
-                                getUrl(collector_host, collector_port).c_str());
+ZipkinHttpTransporter::ZipkinHttpTransporter(
+    const char *collector_host, uint32_t collector_port,
+    std::chrono::milliseconds collector_timeout, SpanEncoding encoding)
+    : ZipkinHttpTransporter{makeHttpTransportOptions(
+          collector_host, collector_port, collector_timeout, encoding)} {}
+
+ZipkinHttpTransporter::ZipkinHttpTransporter(
+    const HttpTransportOptions &options)
+    : stream_request_body_{options.stream_request_body},
+      is_compressed_{options.compression_level > 0},
+      max_retries_{std::max(options.max_retries, 0)},
+      retry_base_delay_{options.retry_base_delay},
+      load_balancing_policy_{options.load_balancing_policy},
+      ejection_time_{options.collector_ejection_time},
+      random_{std::random_device{}()}, replay_backoff_{MIN_REPLAY_BACKOFF} {
+  if (multi_handle_ == nullptr) {
+    throw CurlError{CURLE_FAILED_INIT};
+  }
+  headers_.append((std::string{"Content-Type: "} +
+                   makeSpanEncoder(options.encoding)->contentType())
+                      .c_str());
+  if (stream_request_body_) {
+    headers_.append("Transfer-Encoding: chunked");
+    // Don't wait for a 100 Continue response before sending the body.
+    headers_.append("Expect:");
+  }
+  if (options.compression_level > 0) {
+    headers_.append("Content-Encoding: gzip");
+  }
+
+  if (options.collector_urls.empty()) {
+    collectors_.emplace_back();
+    collectors_.back().url = getUrl(options.collector_host.c_str(),
+                                    options.collector_port, options.encoding);
+  }
+  for (const auto &collector_url : options.collector_urls) {
+    collectors_.emplace_back();
+    collectors_.back().url = getUrl(collector_url, options.encoding);
+  }
+  for (auto &collector : collectors_) {
+    collector.overload_backoff = retry_base_delay_;
+  }
+  if (load_balancing_policy_ == LoadBalancingPolicy::TRACE_ID_HASH &&
+      collectors_.size() > 1) {
+    routed_spans_.resize(collectors_.size());
+  }
+
+  auto num_requests = std::max<size_t>(options.max_inflight_requests, 1);
+  for (size_t i = 0; i < num_requests; ++i) {
+    std::unique_ptr<Request> request{new Request{}};
+    request->encoder = makeRequestEncoder(options);
+    setUpRequest(*request, options.collector_timeout);
+    free_requests_.push_back(request.get());
+    requests_.push_back(std::move(request));
+  }
+
+  if (!options.spool_directory.empty()) {
+    try {
+      spool_.reset(new SpanSpool{options.spool_directory,
+                                 options.spool_max_bytes,
+                                 getSpoolFormat(options)});
+      replay_request_.reset(new Request{});
+      setUpRequest(*replay_request_, options.collector_timeout);
+    } catch (const std::system_error &error) {
+      std::cerr << "Spooling disabled: " << error.what() << '\n';
+      spool_.reset();
+    }
+  }
+
+  io_thread_ = std::thread(&ZipkinHttpTransporter::performRequests, this);
+}
+
+ZipkinHttpTransporter::~ZipkinHttpTransporter() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    exit_ = true;
+  }
+  wakeUpIoThread();
+  io_thread_.join();
+}
+
+void ZipkinHttpTransporter::setUpRequest(
+    Request &request, std::chrono::milliseconds collector_timeout) {
+  // The URL is set each time the request is started.
+  auto &handle = request.handle;
+  auto rcode = curl_easy_setopt(handle, CURLOPT_HTTPHEADER,
+                           static_cast<curl_slist *>(headers_));
   if (rcode != CURLE_OK) {
     throw CurlError{rcode};
   }
 
-  headers_.append("Content-Type: application/json");
-  rcode = curl_easy_setopt(handle_, CURLOPT_HTTPHEADER,
-                           static_cast<curl_slist *>(headers_));
+  rcode = curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, request.error_buffer);
   if (rcode != CURLE_OK) {
     throw CurlError{rcode};
   }
 
-  rcode = curl_easy_setopt(handle_, CURLOPT_ERRORBUFFER, error_buffer_);
+  rcode = curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS,
+                           static_cast<long>(collector_timeout.count()));
   if (rcode != CURLE_OK) {
     throw CurlError{rcode};
   }
 
-  rcode = curl_easy_setopt(handle_, CURLOPT_TIMEOUT_MS, collector_timeout.count());
+  // Requests are made from a thread other than the main one, where signals
+  // can't be used to time out name resolution.
+  rcode = curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
   if (rcode != CURLE_OK) {
     throw CurlError{rcode};
   }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_PRIVATE, &request);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION,
+                           &ZipkinHttpTransporter::readResponseHeader);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_HEADERDATA, &request);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  if (!stream_request_body_) {
+    return;
+  }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_POST, 1L);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_READFUNCTION,
+                           &ZipkinHttpTransporter::readRequestBody);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_READDATA, &request);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  // libcurl rewinds the body when it retries a request on a new connection,
+  // for instance after the collector closed a kept-alive one.
+  rcode = curl_easy_setopt(handle, CURLOPT_SEEKFUNCTION,
+                           &ZipkinHttpTransporter::seekRequestBody);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+
+  rcode = curl_easy_setopt(handle, CURLOPT_SEEKDATA, &request);
+  if (rcode != CURLE_OK) {
+    throw CurlError{rcode};
+  }
+}
+
+void ZipkinHttpTransporter::startRequestBody(Request &request) {
+  request.next_span = 0;
+  request.body_offset = 0;
+  request.is_body_complete = false;
+  request.is_body_preencoded = false;
+  request.body.Clear();
+  request.encoder->startList(request.body);
+}
+
+int ZipkinHttpTransporter::seekRequestBody(void *context, curl_off_t offset,
+                                           int origin) {
+  if (offset != 0 || origin != SEEK_SET) {
+    return CURL_SEEKFUNC_CANTSEEK;
+  }
+  auto &request = *static_cast<Request *>(context);
+  if (request.is_body_preencoded) {
+    request.body_offset = 0;
+  } else {
+    startRequestBody(request);
+  }
+  return CURL_SEEKFUNC_OK;
 }
 
-ZipkinHttpTransporter::~ZipkinHttpTransporter() {}
+size_t ZipkinHttpTransporter::readRequestBody(char *buffer, size_t size,
+                                              size_t count, void *context) {
+  auto &request = *static_cast<Request *>(context);
+  auto &body = request.body;
+  auto capacity = size * count;
+  size_t num_read = 0;
+  while (num_read < capacity) {
+    if (request.body_offset == body.GetSize()) {
+      if (request.is_body_complete) {
+        break;
+      }
+      // Encode enough spans to fill the rest of libcurl's buffer.
+      body.Clear();
+      request.body_offset = 0;
+      while (body.GetSize() < capacity - num_read &&
+             request.next_span < request.spans.pendingSpans()) {
+        request.encoder->addSpan(request.spans.span(request.next_span++));
+      }
+      if (request.next_span == request.spans.pendingSpans()) {
+        request.encoder->endList();
+        request.is_body_complete = true;
+      }
+    }
+    auto chunk_size =
+        std::min(capacity - num_read, body.GetSize() - request.body_offset);
+    std::memcpy(buffer + num_read, body.GetString() + request.body_offset,
+                chunk_size);
+    request.body_offset += chunk_size;
+    num_read += chunk_size;
+  }
+  return num_read;
+}
 
-void ZipkinHttpTransporter::transportSpans(SpanBuffer &spans) try {
-  auto data = spans.toStringifiedJsonArray();
-  auto rcode = curl_easy_setopt(handle_, CURLOPT_POSTFIELDS, data.c_str());
+size_t ZipkinHttpTransporter::readResponseHeader(char *buffer, size_t size,
+                                                 size_t count, void *context) {
+  auto &request = *static_cast<Request *>(context);
+  auto length = size * count;
+  if (hasHeaderName(buffer, length, "retry-after")) {
+    const size_t value_offset = sizeof("retry-after:") - 1;
+    request.retry_after =
+        parseRetryAfter(buffer + value_offset, length - value_offset);
+  }
+  return length;
+}
+
+ZipkinHttpTransporter::Request *ZipkinHttpTransporter::acquireRequest() {
+  auto wait_end = SteadyClock::now() + MAX_REQUEST_WAIT;
+  std::unique_lock<std::mutex> lock{mutex_};
+  // The deadline is read again after each wakeup, since setDeadline() may
+  // have brought it forward.
+  while (free_requests_.empty()) {
+    auto deadline = std::min(wait_end, deadline_);
+    if (SteadyClock::now() >= deadline) {
+      return nullptr;
+    }
+    cond_.wait_until(lock, deadline);
+  }
+  auto request = free_requests_.back();
+  free_requests_.pop_back();
+  request->route = NO_ROUTE;
+  request->num_retries = 0;
+  request->start_time = SteadyTime{};
+  return request;
+}
+
+bool ZipkinHttpTransporter::setPostFields(Request &request) {
+  // The size is set explicitly since binary encodings may contain zeros.
+  auto rcode = curl_easy_setopt(request.handle, CURLOPT_POSTFIELDSIZE,
+                                static_cast<long>(request.body.GetSize()));
+  if (rcode == CURLE_OK) {
+    rcode = curl_easy_setopt(request.handle, CURLOPT_POSTFIELDS,
+                             request.body.GetString());
+  }
   if (rcode != CURLE_OK) {
     std::cerr << curl_easy_strerror(rcode) << '\n';
+    return false;
+  }
+  return true;
+}
+
+void ZipkinHttpTransporter::queueRequest(Request &request) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    queued_requests_.push_back(&request);
+  }
+  wakeUpIoThread();
+}
+
+void ZipkinHttpTransporter::transportSpans(SpanBuffer &spans) {
+  if (routed_spans_.empty()) {
+    transportBatch(spans, NO_ROUTE);
+    return;
+  }
+  for (auto &routed_spans : routed_spans_) {
+    routed_spans.allocateBuffer(spans.pendingSpans());
+  }
+  // The spans are moved rather than copied, since the batch is cleared once
+  // it has been transported.
+  for (size_t i = 0; i < spans.pendingSpans(); ++i) {
+    auto route =
+        routeTraceId(spans.span(i).traceId(), routed_spans_.size());
+    routed_spans_[route].addSpan(spans.takeSpan(i));
+  }
+  for (size_t route = 0; route < routed_spans_.size(); ++route) {
+    auto &routed_spans = routed_spans_[route];
+    if (routed_spans.pendingSpans() > 0) {
+      transportBatch(routed_spans, route);
+      routed_spans.clear();
+    }
+  }
+}
+
+void ZipkinHttpTransporter::transportBatch(SpanBuffer &spans, size_t route) {
+  auto request = acquireRequest();
+  if (request == nullptr) {
+    dropBatch(spans.pendingSpans());
+    return;
+  }
+  request->num_spans = spans.pendingSpans();
+  request->route = route;
+
+  if (stream_request_body_) {
+    // The spans are encoded on the I/O thread as the body is read.
+    request->spans.swap(spans);
+    startRequestBody(*request);
+  } else {
+    try {
+      auto &body = request->body;
+      body.Clear();
+      // Leave room for the null terminator added by GetString(). Compressed
+      // bodies are grown as they are deflated.
+      if (!is_compressed_) {
+        body.Reserve(spans.encodedSizeEstimate() + 1);
+      }
+      spans.encode(*request->encoder, body);
+    } catch (const std::bad_alloc &) {
+      // Drop spans
+      num_spans_dropped_ += request->num_spans;
+      completeRequest(*request, false);
+      return;
+    }
+    if (!setPostFields(*request)) {
+      num_spans_dropped_ += request->num_spans;
+      completeRequest(*request, false);
+      return;
+    }
+  }
+  queueRequest(*request);
+}
+
+void ZipkinHttpTransporter::transportEncodedSpans(const char *data,
+                                                  size_t size,
+                                                  size_t num_spans) {
+  auto request = acquireRequest();
+  if (request == nullptr) {
+    dropBatch(num_spans);
+    return;
+  }
+  request->num_spans = num_spans;
+  try {
+    auto &body = request->body;
+    body.Clear();
+    if (is_compressed_) {
+      static_cast<GzipSpanEncoder &>(*request->encoder)
+          .compress(data, size, body);
+    } else {
+      std::memcpy(body.Push(size), data, size);
+    }
+  } catch (const std::bad_alloc &) {
+    // Drop spans
+    num_spans_dropped_ += request->num_spans;
+    completeRequest(*request, false);
+    return;
+  }
+
+  if (stream_request_body_) {
+    // libcurl reads the body from the buffer as it is.
+    request->next_span = 0;
+    request->body_offset = 0;
+    request->is_body_complete = true;
+    request->is_body_preencoded = true;
+  } else if (!setPostFields(*request)) {
+    num_spans_dropped_ += request->num_spans;
+    completeRequest(*request, false);
     return;
   }
-  rcode = curl_easy_perform(handle_);
+  queueRequest(*request);
+}
+
+bool ZipkinHttpTransporter::setCompletionCallback(TransportCallback callback) {
+  completion_callback_ = std::move(callback);
+  return true;
+}
+
+void ZipkinHttpTransporter::flush(SteadyTime deadline) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  cond_.wait_until(lock, deadline, [this] {
+    return this->free_requests_.size() == this->requests_.size();
+  });
+}
+
+void ZipkinHttpTransporter::setDeadline(SteadyTime deadline) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    deadline_ = deadline;
+  }
+  cond_.notify_all();
+}
+
+void ZipkinHttpTransporter::dropBatch(size_t num_spans) {
+  std::cerr << "Zipkin collector busy: dropping " << num_spans << " spans\n";
+  num_spans_dropped_ += num_spans;
+  if (completion_callback_) {
+    completion_callback_(0, num_spans);
+  }
+}
+
+void ZipkinHttpTransporter::wakeUpIoThread() {
+#if LIBCURL_VERSION_NUM >= 0x074400
+  curl_multi_wakeup(multi_handle_);
+#endif
+  cond_.notify_all();
+}
+
+void ZipkinHttpTransporter::completeRequest(Request &request,
+                                            bool succeeded) {
+  // Report completion before making the request available, so that a flush()
+  // does not return before the reporter knows what became of the spans.
+  if (completion_callback_) {
+    auto num_spans_sent = succeeded ? request.num_spans : 0;
+    completion_callback_(num_spans_sent, request.num_spans - num_spans_sent);
+  }
+  request.spans.clear();
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    free_requests_.push_back(&request);
+  }
+  cond_.notify_all();
+}
+
+void ZipkinHttpTransporter::spoolRequest(Request &request) {
+  auto &body = request.body;
+  try {
+    if (stream_request_body_ && !request.is_body_preencoded) {
+      // Only a chunk of a streamed body is kept, so encode it again.
+      body.Clear();
+      request.spans.encode(*request.encoder, body);
+    }
+  } catch (const std::bad_alloc &) {
+    num_spans_dropped_ += request.num_spans;
+    return;
+  }
+  if (!spool_->append(body.GetString(), body.GetSize(),
+                      static_cast<uint32_t>(request.num_spans))) {
+    num_spans_dropped_ += request.num_spans;
+  }
+}
+
+SteadyClock::duration
+ZipkinHttpTransporter::jitter(SteadyClock::duration delay) {
+  // Between half the delay and the whole of it, so that clients that failed
+  // together don't retry together.
+  std::uniform_int_distribution<SteadyClock::rep> distribution{
+      0, delay.count() / 2};
+  return delay - SteadyClock::duration{distribution(random_)};
+}
+
+ZipkinHttpTransporter::RequestResult
+ZipkinHttpTransporter::checkResult(Request &request, CURLcode rcode) {
+  auto &collector = collectors_[request.collector];
+  --collector.num_outstanding;
+  long status = 0;
   if (rcode != CURLE_OK) {
-    std::cerr << error_buffer_ << '\n';
+    std::cerr << request.error_buffer << '\n';
+  } else {
+    curl_easy_getinfo(request.handle, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 200 && status < 300) {
+      collector.num_failures = 0;
+      collector.overload_backoff = retry_base_delay_;
+      return RequestResult::SUCCEEDED;
+    }
+    std::cerr << "Zipkin collector " << collector.url
+              << " responded with status " << status << '\n';
+  }
+
+  auto now = SteadyClock::now();
+  if (status == 429 || status == 503) {
+    // The collector is overloaded, so hold back every request to it, not
+    // just this one.
+    auto delay = request.retry_after > SteadyClock::duration::zero()
+                     ? request.retry_after
+                     : jitter(collector.overload_backoff);
+    collector.overload_backoff =
+        std::min(collector.overload_backoff * 2, MAX_RETRY_DELAY);
+    collector.paused_until = std::max(collector.paused_until, now + delay);
+  } else if (rcode == CURLE_OK && status != 408 && status < 500) {
+    collector.num_failures = 0;
+    return RequestResult::PERMANENT_FAILURE;
+  }
+  if (++collector.num_failures >= MAX_CONSECUTIVE_FAILURES) {
+    collector.num_failures = 0;
+    collector.ejected_until = now + ejection_time_;
+  }
+  return RequestResult::RETRYABLE_FAILURE;
+}
+
+void ZipkinHttpTransporter::retryRequest(Request &request) {
+  auto delay = retry_base_delay_;
+  for (int i = 0; i < request.num_retries && delay < MAX_RETRY_DELAY; ++i) {
+    delay *= 2;
+  }
+  ++request.num_retries;
+  request.start_time = SteadyClock::now() +
+                       std::max(jitter(std::min(delay, MAX_RETRY_DELAY)),
+                                request.retry_after);
+  if (stream_request_body_) {
+    if (request.is_body_preencoded) {
+      request.body_offset = 0;
+    } else {
+      startRequestBody(request);
+    }
+  }
+  pending_requests_.push_back(&request);
+}
+
+void ZipkinHttpTransporter::recordResult(bool succeeded) {
+  if (succeeded) {
+    // The collector is reachable, so start sending spooled batches.
+    replay_backoff_ = MIN_REPLAY_BACKOFF;
+    next_replay_time_ = SteadyClock::now();
+    return;
+  }
+  next_replay_time_ = SteadyClock::now() + replay_backoff_;
+  replay_backoff_ = std::min(replay_backoff_ * 2, MAX_REPLAY_BACKOFF);
+}
+
+bool ZipkinHttpTransporter::isReplayDue() const {
+  return spool_ != nullptr && !is_replaying_ && !spool_->empty();
+}
+
+SteadyTime ZipkinHttpTransporter::resumeTime() const {
+  auto result = SteadyTime::max();
+  for (const auto &collector : collectors_) {
+    result = std::min(result, collector.paused_until);
+  }
+  return result;
+}
+
+SteadyTime ZipkinHttpTransporter::nextStartTime() const {
+  auto result = SteadyTime::max();
+  for (auto request : pending_requests_) {
+    result = std::min(result, request->start_time);
+  }
+  if (isReplayDue()) {
+    result = std::min(result, next_replay_time_);
+  }
+  return result == SteadyTime::max() ? result : std::max(result, resumeTime());
+}
+
+bool ZipkinHttpTransporter::chooseCollector(Request &request, SteadyTime now) {
+  auto num_collectors = collectors_.size();
+  auto is_usable = [this, now](size_t index, bool healthy_only) {
+    const auto &collector = this->collectors_[index];
+    return collector.paused_until <= now &&
+           (!healthy_only || collector.ejected_until <= now);
+  };
+  // Ejected collectors are only used if no other can be.
+  auto chosen = num_collectors;
+  for (auto healthy_only : {true, false}) {
+    if (request.route != NO_ROUTE) {
+      // A route whose collector can't be used falls back to the next one.
+      for (size_t i = 0; i < num_collectors && chosen == num_collectors; ++i) {
+        auto index = (request.route + i) % num_collectors;
+        if (is_usable(index, healthy_only)) {
+          chosen = index;
+        }
+      }
+    } else {
+      for (size_t i = 0; i < num_collectors; ++i) {
+        auto index = (next_collector_ + i) % num_collectors;
+        if (!is_usable(index, healthy_only)) {
+          continue;
+        }
+        if (chosen == num_collectors ||
+            collectors_[index].num_outstanding <
+                collectors_[chosen].num_outstanding) {
+          chosen = index;
+        }
+        if (load_balancing_policy_ != LoadBalancingPolicy::LEAST_OUTSTANDING) {
+          break;
+        }
+      }
+    }
+    if (chosen != num_collectors) {
+      break;
+    }
+  }
+  if (chosen == num_collectors) {
+    return false;
+  }
+  if (request.route == NO_ROUTE) {
+    next_collector_ = chosen + 1;
+  }
+
+  auto &collector = collectors_[chosen];
+  auto rcode =
+      curl_easy_setopt(request.handle, CURLOPT_URL, collector.url.c_str());
+  if (rcode != CURLE_OK) {
+    std::cerr << curl_easy_strerror(rcode) << '\n';
+    return false;
+  }
+  request.collector = chosen;
+  ++collector.num_outstanding;
+  return true;
+}
+
+void ZipkinHttpTransporter::startRequest(
+    Request &request, std::vector<Request *> &active_requests) {
+  request.retry_after = SteadyClock::duration::zero();
+  if (!chooseCollector(request, SteadyClock::now())) {
+    num_spans_dropped_ += request.num_spans;
+    completeRequest(request, false);
+    return;
+  }
+  auto rcode = curl_multi_add_handle(multi_handle_, request.handle);
+  if (rcode != CURLM_OK) {
+    std::cerr << curl_multi_strerror(rcode) << '\n';
+    --collectors_[request.collector].num_outstanding;
+    num_spans_dropped_ += request.num_spans;
+    completeRequest(request, false);
+    return;
+  }
+  active_requests.push_back(&request);
+}
+
+void ZipkinHttpTransporter::startDueRequests(
+    std::vector<Request *> &active_requests) {
+  // Nothing is started while every collector is overloaded.
+  auto now = SteadyClock::now();
+  if (now < resumeTime()) {
+    return;
+  }
+  if (isReplayDue() && now >= next_replay_time_) {
+    startReplay(active_requests);
+  }
+  // Requests are started in the order they were queued or failed.
+  size_t num_waiting = 0;
+  for (auto request : pending_requests_) {
+    if (request->start_time > now) {
+      pending_requests_[num_waiting++] = request;
+      continue;
+    }
+    startRequest(*request, active_requests);
+  }
+  pending_requests_.resize(num_waiting);
+}
+
+void ZipkinHttpTransporter::startReplay(
+    std::vector<Request *> &active_requests) {
+  auto &request = *replay_request_;
+  std::string batch;
+  uint32_t num_spans;
+  if (!spool_->front(batch, num_spans)) {
+    return;
+  }
+  request.num_spans = num_spans;
+  request.retry_after = SteadyClock::duration::zero();
+  request.body.Clear();
+  std::memcpy(request.body.Push(batch.size()), batch.data(), batch.size());
+  if (!setPostFields(request) ||
+      !chooseCollector(request, SteadyClock::now())) {
+    recordResult(false);
+    return;
+  }
+  if (curl_multi_add_handle(multi_handle_, request.handle) != CURLM_OK) {
+    --collectors_[request.collector].num_outstanding;
+    recordResult(false);
+    return;
+  }
+  is_replaying_ = true;
+  active_requests.push_back(&request);
+}
+
+void ZipkinHttpTransporter::completeReplay(RequestResult result) {
+  is_replaying_ = false;
+  // A batch that may yet be accepted stays at the front of the spool.
+  if (result == RequestResult::RETRYABLE_FAILURE) {
+    return;
+  }
+  if (result == RequestResult::PERMANENT_FAILURE) {
+    num_spans_dropped_ += replay_request_->num_spans;
+  }
+  spool_->pop();
+}
+
+void ZipkinHttpTransporter::performRequests() {
+  std::vector<Request *> active_requests;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      // While requests are active, the thread waits on their sockets below
+      // instead.
+      auto has_work = [this, &active_requests] {
+        return this->exit_ || !active_requests.empty() ||
+               !this->queued_requests_.empty();
+      };
+      auto next_start_time = nextStartTime();
+      if (next_start_time != SteadyTime::max()) {
+        cond_.wait_until(lock, next_start_time, has_work);
+      } else {
+        cond_.wait(lock, has_work);
+      }
+      if (exit_) {
+        break;
+      }
+      pending_requests_.insert(pending_requests_.end(),
+                               queued_requests_.begin(),
+                               queued_requests_.end());
+      queued_requests_.clear();
+    }
+
+    startDueRequests(active_requests);
+
+    int num_running;
+    curl_multi_perform(multi_handle_, &num_running);
+
+    CURLMsg *message;
+    int num_messages;
+    while ((message = curl_multi_info_read(multi_handle_, &num_messages))) {
+      if (message->msg != CURLMSG_DONE) {
+        continue;
+      }
+      char *private_data;
+      curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &private_data);
+      auto request = reinterpret_cast<Request *>(private_data);
+      auto result = checkResult(*request, message->data.result);
+      curl_multi_remove_handle(multi_handle_, message->easy_handle);
+      active_requests.erase(std::find(active_requests.begin(),
+                                      active_requests.end(), request));
+      // Any response shows that the collector can be reached.
+      recordResult(result != RequestResult::RETRYABLE_FAILURE);
+      if (request == replay_request_.get()) {
+        completeReplay(result);
+        continue;
+      }
+      if (result == RequestResult::RETRYABLE_FAILURE &&
+          request->num_retries < max_retries_) {
+        retryRequest(*request);
+        continue;
+      }
+      if (result == RequestResult::RETRYABLE_FAILURE && spool_ != nullptr) {
+        spoolRequest(*request);
+      } else if (result != RequestResult::SUCCEEDED) {
+        num_spans_dropped_ += request->num_spans;
+      }
+      completeRequest(*request, result == RequestResult::SUCCEEDED);
+    }
+
+    if (!active_requests.empty()) {
+      // Wake up in time to start the next delayed request.
+      auto timeout = std::chrono::milliseconds{1000};
+      auto next_start_time = nextStartTime();
+      if (next_start_time != SteadyTime::max()) {
+        timeout = std::min(
+            timeout,
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::max(next_start_time - SteadyClock::now(),
+                         SteadyClock::duration::zero())) +
+                std::chrono::milliseconds{1});
+      }
+#if LIBCURL_VERSION_NUM >= 0x074400
+      curl_multi_poll(multi_handle_, nullptr, 0,
+                      static_cast<int>(timeout.count()), nullptr);
+#else
+      // Without curl_multi_wakeup(), wait briefly so that newly queued
+      // requests are started promptly.
+      curl_multi_wait(multi_handle_, nullptr, 0,
+                      static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+                          timeout.count(), 10)),
+                      nullptr);
+#endif
+    }
+  }
+
+  // Abandon the requests still in flight.
+  for (auto request : active_requests) {
+    curl_multi_remove_handle(multi_handle_, request->handle);
   }
-} catch (const std::bad_alloc &) {
-  // Drop spans
 }
 
 ReporterPtr makeHttpReporter(const char *collector_host,
                              uint32_t collector_port,
                              std::chrono::milliseconds collector_timeout,
                              SteadyClock::duration reporting_period,
-                             size_t max_buffered_spans) try {
+                             size_t max_buffered_spans,
+                             SpanEncoding encoding) {
+  ReporterOptions reporter_options;
+  reporter_options.reporting_period = reporting_period;
+  reporter_options.max_buffered_spans = max_buffered_spans;
+  return makeHttpReporter(collector_host, collector_port, collector_timeout,
+                          encoding, reporter_options);
+}
+
+ReporterPtr makeHttpReporter(const char *collector_host,
+                             uint32_t collector_port,
+                             std::chrono::milliseconds collector_timeout,
+                             SpanEncoding encoding,
+                             const ReporterOptions &options) {
+  return makeHttpReporter(makeHttpTransportOptions(collector_host,
+                                                   collector_port,
+                                                   collector_timeout, encoding),
+                          options);
+}
+
+ReporterPtr makeHttpReporter(const HttpTransportOptions &transport_options,
+                             const ReporterOptions &reporter_options) try {
   std::unique_ptr<Transporter> transporter{
-      new ZipkinHttpTransporter{collector_host, collector_port, collector_timeout}};
-  std::unique_ptr<Reporter> reporter{new ReporterImpl{
-      std::move(transporter), reporting_period, max_buffered_spans}};
+      new ZipkinHttpTransporter{transport_options}};
+  std::unique_ptr<Reporter> reporter{
+      new ReporterImpl{std::move(transporter), reporter_options}};
   return reporter;
 } catch (const CurlError &error) {
   std::cerr << error.what() << '\n';
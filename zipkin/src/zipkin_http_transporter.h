@@ -3,10 +3,18 @@
 #include "transporter.h"
 #include "zipkin_reporter_impl.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <curl/curl.h>
 #include <exception>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
 
 namespace zipkin {
+class SpanSpool;
+
 /**
  * Exception class used for CURL errors.
  */
@@ -50,6 +58,21 @@ private:
   CURL *handle_;
 };
 
+/**
+ * RAII class to manage the allocation/deallocation of a CURL multi handle.
+ */
+class CurlMultiHandle {
+public:
+  CurlMultiHandle() { handle_ = curl_multi_init(); }
+
+  ~CurlMultiHandle() { curl_multi_cleanup(handle_); }
+
+  operator CURLM *() { return handle_; }
+
+private:
+  CURLM *handle_;
+};
+
 /**
  * RAII class to manage the allocation/deallocation of a CURL SList
  */
@@ -77,6 +100,42 @@ private:
 /**
  * This class derives from the abstract zipkin::Transporter. It sends spans to
  * a zipkin collector via http.
+ *
+ * Requests are made with the CURL multi interface from a dedicated thread, so
+ * that transportSpans() only has to encode the spans. Up to
+ * max_inflight_requests batches are sent at once, over connections that are
+ * kept open between requests. transportSpans() blocks when that many batches
+ * are already in flight.
+ *
+ * By default, transportSpans() encodes the whole batch into the request body.
+ * With stream_request_body, it instead hands the spans to the request, which
+ * encodes them a chunk at a time as libcurl reads the body.
+ *
+ * With a compression_level, the encoded spans are gzipped as they are
+ * encoded, in either mode; see GzipSpanEncoder.
+ *
+ * With a spool_directory, batches that fail to send are kept in a SpanSpool.
+ * The I/O thread sends them again, oldest first and one at a time, on a
+ * request of their own so that new batches don't wait behind them. Replay
+ * starts once a request succeeds, and is retried with exponential backoff
+ * while requests fail. Without a spool, failed batches are dropped.
+ *
+ * A batch counts as sent once the collector responds with a 2xx status.
+ * Transport errors and 408, 429 and 5xx responses are retried up to
+ * max_retries times, with jittered exponential backoff, before the batch is
+ * spooled or dropped; other statuses drop the batch at once. While the
+ * collector signals overload, with a 429 or 503, the I/O thread starts no
+ * requests until its Retry-After has passed, or a backoff that grows while
+ * the overload lasts. The requests held back keep transportSpans() waiting,
+ * which slows the reporter down until the collector recovers.
+ *
+ * Batches can be spread across several collectors, according to a
+ * LoadBalancingPolicy. The collector is chosen each time a request is
+ * started, so that retries can go to another one. Collectors are tracked
+ * passively: one that fails several requests in a row is avoided for the
+ * collector_ejection_time, and one that signals overload is avoided until its
+ * backoff has passed. Requests are only held back while every collector is
+ * overloaded.
  */
 class ZipkinHttpTransporter : public Transporter {
 public:
@@ -87,28 +146,199 @@ public:
    * service.
    * @param collector_port The port to use when sending spans to the Zipkin service.
    * @param collector_timeout Timeout for http requests
+   * @param encoding The format to send spans in. It also determines the
+   * collector endpoint that spans are posted to.
    *
    * Throws CurlError if the handle can't be initialized.
    */
   ZipkinHttpTransporter(const char *collector_host, uint32_t collector_port,
-          std::chrono::milliseconds collector_timeout = DEFAULT_TRANSPORT_TIMEOUT);
+          std::chrono::milliseconds collector_timeout = DEFAULT_TRANSPORT_TIMEOUT,
+          SpanEncoding encoding = SpanEncoding::JSON_V1);
 
   /**
-   * Destructor.
+   * Constructor.
+   *
+   * @param options The options that control how spans are sent.
+   *
+   * Throws CurlError if the handles can't be initialized.
+   */
+  explicit ZipkinHttpTransporter(const HttpTransportOptions &options);
+
+  /**
+   * Destructor. Requests still in flight are abandoned.
    */
   ~ZipkinHttpTransporter();
 
   /**
    * Implementation of zipkin::Transporter::transportSpans().
    *
+   * Encodes the spans, or takes them if request bodies are streamed, and
+   * queues them to be sent. Waits first for a request to complete if
+   * max_inflight_requests are in flight, and drops the spans if none does
+   * within a few seconds or by the deadline given to setDeadline().
+   *
    * @param spans The spans to be transported.
    */
   void transportSpans(SpanBuffer &spans) override;
 
+  /**
+   * Queues a list of spans that is already encoded in the transporter's
+   * encoding to be sent, for instance spans forwarded from another process.
+   * The list is compressed first if the transporter compresses bodies.
+   *
+   * @param data The encoded list of spans.
+   * @param size The size of the encoded list.
+   * @param num_spans The number of spans in the list, passed to the
+   * completion callback.
+   */
+  void transportEncodedSpans(const char *data, size_t size, size_t num_spans);
+
+  /**
+   * Implementation of zipkin::Transporter::setCompletionCallback().
+   */
+  bool setCompletionCallback(TransportCallback callback) override;
+
+  /**
+   * Implementation of zipkin::Transporter::flush().
+   */
+  void flush(SteadyTime deadline) override;
+
+  /**
+   * Implementation of zipkin::Transporter::setDeadline().
+   */
+  void setDeadline(SteadyTime deadline) override;
+
+  /**
+   * Implementation of zipkin::Transporter::numSpansDropped().
+   */
+  uint64_t numSpansDropped() const override { return num_spans_dropped_; }
+
 private:
+  /**
+   * A request to the collector, reused for successive batches.
+   */
+  struct Request {
+    CurlHandle handle;
+    char error_buffer[CURL_ERROR_SIZE];
+    SpanEncoderPtr encoder;
+
+    // Spans are encoded into this buffer. It is kept across flushes so that,
+    // once it has grown to the size of a typical batch, encoding does not
+    // allocate. When the body is streamed, it holds the current chunk.
+    rapidjson::StringBuffer body;
+    size_t num_spans = 0;
+
+    // The state of a streamed body: the spans being sent, the next one to
+    // encode, and how much of the current chunk has been read.
+    SpanBuffer spans;
+    size_t next_span = 0;
+    size_t body_offset = 0;
+    bool is_body_complete = false;
+    // Set if the whole streamed body was encoded up front, by
+    // transportEncodedSpans().
+    bool is_body_preencoded = false;
+
+    // The collector the request was last sent to, and the one its spans are
+    // routed to by trace ID, if any.
+    size_t collector = 0;
+    size_t route = NO_ROUTE;
+
+    // The number of times the batch has been retried, and the earliest time
+    // the I/O thread may start the request.
+    int num_retries = 0;
+    SteadyTime start_time;
+    // The delay asked for by the Retry-After header of the last response.
+    SteadyClock::duration retry_after;
+  };
+
+  enum class RequestResult { SUCCEEDED, RETRYABLE_FAILURE, PERMANENT_FAILURE };
+
+  /**
+   * A collector, and what the I/O thread knows of its health.
+   */
+  struct Collector {
+    std::string url;
+    size_t num_outstanding = 0;
+    int num_failures = 0;
+    // Avoided until then, because of failures or overload. Requests are only
+    // held back for overload.
+    SteadyTime ejected_until;
+    SteadyTime paused_until;
+    SteadyClock::duration overload_backoff;
+  };
+
+  static const size_t NO_ROUTE = static_cast<size_t>(-1);
+
   CurlEnvironment curl_environment_;
-  CurlHandle handle_;
+  CurlMultiHandle multi_handle_;
   CurlSList headers_;
-  char error_buffer_[CURL_ERROR_SIZE];
+  bool stream_request_body_;
+  bool is_compressed_;
+  int max_retries_;
+  SteadyClock::duration retry_base_delay_;
+  LoadBalancingPolicy load_balancing_policy_;
+  SteadyClock::duration ejection_time_;
+  // Batches split by trace ID, when routing by trace ID. Only used by the
+  // thread calling transportSpans().
+  std::vector<SpanBuffer> routed_spans_;
+  TransportCallback completion_callback_;
+  std::vector<std::unique_ptr<Request>> requests_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // Requests not in use, and requests waiting for the I/O thread to start
+  // them. Guarded by mutex_.
+  std::vector<Request *> free_requests_;
+  std::vector<Request *> queued_requests_;
+  bool exit_ = false;
+  SteadyTime deadline_ = SteadyTime::max();
+  std::atomic<uint64_t> num_spans_dropped_{0};
+
+  // Requests queued or waiting to be retried, that the I/O thread has yet to
+  // start, and the collectors to send them to. Only used by the I/O thread.
+  std::vector<Request *> pending_requests_;
+  std::vector<Collector> collectors_;
+  size_t next_collector_ = 0;
+  std::minstd_rand random_;
+
+  // Batches that failed to send, and the request used to send them again.
+  // Only used by the I/O thread.
+  std::unique_ptr<SpanSpool> spool_;
+  std::unique_ptr<Request> replay_request_;
+  bool is_replaying_ = false;
+  SteadyTime next_replay_time_;
+  SteadyClock::duration replay_backoff_;
+
+  std::thread io_thread_;
+
+  Request *acquireRequest();
+  void dropBatch(size_t num_spans);
+  bool setPostFields(Request &request);
+  void queueRequest(Request &request);
+  void transportBatch(SpanBuffer &spans, size_t route);
+  void setUpRequest(Request &request,
+                    std::chrono::milliseconds collector_timeout);
+  static void startRequestBody(Request &request);
+  static size_t readRequestBody(char *buffer, size_t size, size_t count,
+                                void *context);
+  static int seekRequestBody(void *context, curl_off_t offset, int origin);
+  static size_t readResponseHeader(char *buffer, size_t size, size_t count,
+                                   void *context);
+  void wakeUpIoThread();
+  void completeRequest(Request &request, bool succeeded);
+  SteadyClock::duration jitter(SteadyClock::duration delay);
+  RequestResult checkResult(Request &request, CURLcode rcode);
+  void retryRequest(Request &request);
+  SteadyTime resumeTime() const;
+  SteadyTime nextStartTime() const;
+  bool chooseCollector(Request &request, SteadyTime now);
+  void startRequest(Request &request, std::vector<Request *> &active_requests);
+  void startDueRequests(std::vector<Request *> &active_requests);
+  void spoolRequest(Request &request);
+  void recordResult(bool succeeded);
+  bool isReplayDue() const;
+  void startReplay(std::vector<Request *> &active_requests);
+  void completeReplay(RequestResult result);
+  void performRequests();
 };
 } // namespace zipkin
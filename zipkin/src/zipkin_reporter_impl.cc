@@ -1,80 +1,260 @@
 #include "zipkin_reporter_impl.h"
+#include <algorithm>
 #include <iostream>
 
 namespace zipkin {
 
+static ReporterOptions makeReporterOptions(
+    std::chrono::steady_clock::duration reporting_period,
+    size_t max_buffered_spans) {
+  ReporterOptions options;
+  options.reporting_period = reporting_period;
+  options.max_buffered_spans = max_buffered_spans;
+  return options;
+}
+
 ReporterImpl::ReporterImpl(TransporterPtr &&transporter,
                            std::chrono::steady_clock::duration reporting_period,
                            size_t max_buffered_spans)
-    : transporter_{std::move(transporter)}, reporting_period_(reporting_period),
-      max_buffered_spans_(max_buffered_spans), spans_{max_buffered_spans},
-      inflight_spans_{max_buffered_spans} {
+    : ReporterImpl{std::move(transporter),
+                   makeReporterOptions(reporting_period, max_buffered_spans)} {}
+
+ReporterImpl::ReporterImpl(TransporterPtr &&transporter,
+                           const ReporterOptions &options)
+    : transporter_{std::move(transporter)},
+      reporting_period_(options.reporting_period),
+      max_buffered_spans_(options.max_buffered_spans),
+      overflow_policy_(options.overflow_policy),
+      overflow_block_timeout_(options.overflow_block_timeout),
+      drain_timeout_(options.drain_timeout),
+      drain_callback_(options.drain_callback),
+      spans_{options.max_buffered_spans, options.max_buffered_bytes},
+      inflight_spans_{options.max_buffered_spans, options.max_buffered_bytes} {
+  async_transport_ =
+      transporter_->setCompletionCallback(
+          [this](size_t num_spans_sent, size_t num_spans_dropped) {
+            num_spans_flushed_ += num_spans_sent;
+            num_spans_unsent_ += num_spans_dropped;
+            notifyAll();
+          });
   writer_ = std::thread(&ReporterImpl::writeReports, this);
 }
 
 ReporterImpl::~ReporterImpl() {
   makeWriterExit();
   writer_.join();
+  // Destroy the transporter while the members its completion callback uses
+  // are still alive.
+  transporter_.reset();
 }
 
 void ReporterImpl::reportSpan(const Span &span) {
-  bool is_full;
-  {
-    std::lock_guard<std::mutex> lock(write_mutex_);
-    num_spans_reported_ += spans_.addSpan(span);
-    is_full = spans_.pendingSpans() == max_buffered_spans_;
+  reportSpan(Span{span});
+}
+
+void ReporterImpl::reportSpan(Span &&span) {
+  bool reached_high_water;
+  if (!spans_.push(std::move(span), reached_high_water)) {
+    bool accepted = false;
+    switch (overflow_policy_) {
+    case OverflowPolicy::DROP_NEWEST:
+      break;
+    case OverflowPolicy::DROP_OLDEST:
+      accepted = pushDroppingOldest(span);
+      break;
+    case OverflowPolicy::BLOCK:
+      accepted = pushBlocking(span);
+      break;
+    }
+    if (!accepted) {
+      ++num_spans_rejected_;
+    }
+  }
+  // Only the first thread to see the queue filling up since the writer last
+  // drained it takes the lock.
+  if (reached_high_water &&
+      !wakeup_requested_.load(std::memory_order_relaxed)) {
+    wakeUpWriter();
+  }
+}
+
+void ReporterImpl::wakeUpWriter() {
+  if (!wakeup_requested_.exchange(true)) {
+    notifyAll();
   }
-  if (is_full)
-    write_cond_.notify_one();
+}
+
+bool ReporterImpl::pushDroppingOldest(Span &span) {
+  // Other threads may take the room made before this one can, so give up
+  // after one attempt per shard rather than retrying indefinitely.
+  bool reached_high_water;
+  for (size_t i = 0; i < spans_.numShards(); ++i) {
+    if (spans_.dropOldest()) {
+      ++num_spans_evicted_;
+    }
+    if (spans_.push(std::move(span), reached_high_water)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReporterImpl::pushBlocking(Span &span) {
+  wakeUpWriter();
+  auto deadline = std::chrono::steady_clock::now() + overflow_block_timeout_;
+  bool accepted = false;
+  std::unique_lock<std::mutex> lock{write_mutex_};
+  write_cond_.wait_until(lock, deadline, [this, &span, &accepted] {
+    bool reached_high_water;
+    accepted = this->spans_.push(std::move(span), reached_high_water);
+    return accepted || this->write_exit_;
+  });
+  return accepted;
+}
+
+void ReporterImpl::notifyAll() {
+  // Taking the lock ensures that a waiting thread is either blocked or has yet
+  // to check its condition, so that the notification is not lost.
+  { std::lock_guard<std::mutex> lock(write_mutex_); }
+  write_cond_.notify_all();
 }
 
 bool ReporterImpl::flushWithTimeout(
     std::chrono::system_clock::duration timeout) {
-  // Note: there is no effort made to speed up the flush when
-  // requested, it simply waits for the regularly scheduled flush
-  // operations to clear out all the presently pending data.
+  // Ask the writer to send everything reported so far right away, rather
+  // than waiting for the next scheduled report.
+  auto num_spans_snapshot = spans_.numPushed();
   std::unique_lock<std::mutex> lock{write_mutex_};
-
-  auto num_spans_snapshot = num_spans_reported_;
-  return write_cond_.wait_for(lock, timeout, [this, num_spans_snapshot] {
-    return this->num_spans_flushed_ >= num_spans_snapshot;
+  flush_target_ = std::max(flush_target_, num_spans_snapshot);
+  write_cond_.notify_all();
+  write_cond_.wait_for(lock, timeout, [this, num_spans_snapshot] {
+    return this->isSettled(num_spans_snapshot);
   });
+  return isFlushed(num_spans_snapshot);
+}
+
+bool ReporterImpl::isFlushed(uint64_t num_spans) const {
+  // Spans discarded to make room for newer ones are never flushed.
+  return num_spans_flushed_ + num_spans_evicted_ >= num_spans;
+}
+
+bool ReporterImpl::isSettled(uint64_t num_spans) const {
+  // Spans the transporter failed to send won't be sent either.
+  return num_spans_flushed_ + num_spans_unsent_ + num_spans_evicted_ >=
+         num_spans;
+}
+
+bool ReporterImpl::isHandedOff(uint64_t num_spans) const {
+  // Once the spans have been given to the transporter, waiting for them to be
+  // sent is left to flushWithTimeout().
+  return num_spans_handed_off_ + num_spans_evicted_ >= num_spans;
+}
+
+ReporterStats ReporterImpl::stats() const {
+  ReporterStats result;
+  result.spans_accepted = spans_.numPushed();
+  result.spans_dropped = num_spans_rejected_ + num_spans_evicted_;
+  result.spans_flushed = num_spans_flushed_;
+  result.spans_dropped_by_transport = transporter_->numSpansDropped();
+  result.spans_drained = num_spans_drained_;
+  result.spans_abandoned = num_spans_abandoned_;
+  return result;
 }
 
 void ReporterImpl::makeWriterExit() {
-  std::lock_guard<std::mutex> lock(write_mutex_);
-  write_exit_ = true;
-  write_cond_.notify_all();
+  SteadyTime drain_deadline;
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    drain_deadline_ = std::chrono::steady_clock::now() + drain_timeout_;
+    drain_deadline = drain_deadline_;
+    write_exit_ = true;
+    write_cond_.notify_all();
+  }
+  // Keep the writer from waiting in the transporter past the deadline, for
+  // instance for room to send a batch.
+  transporter_->setDeadline(drain_deadline);
 }
 
 bool ReporterImpl::waitUntilNextReport(const SteadyTime &due_time) {
   std::unique_lock<std::mutex> lock{write_mutex_};
-  write_cond_.wait_until(lock, due_time, [this] { return this->write_exit_; });
-  if (!write_exit_) {
-    inflight_spans_.swap(spans_);
-  }
+  write_cond_.wait_until(lock, due_time, [this] {
+    return this->write_exit_ || this->wakeup_requested_ ||
+           !this->isHandedOff(this->flush_target_);
+  });
+  wakeup_requested_ = false;
   return !write_exit_;
 }
 
 void ReporterImpl::writeReports() {
   auto due_time = std::chrono::steady_clock::now() + reporting_period_;
   while (waitUntilNextReport(due_time)) {
+    if (spans_.drain(inflight_spans_) > 0 &&
+        overflow_policy_ == OverflowPolicy::BLOCK) {
+      // Let threads waiting for room in the queue retry.
+      notifyAll();
+    }
     if (inflight_spans_.pendingSpans() > 0) {
-      transporter_->transportSpans(inflight_spans_);
-      num_spans_flushed_ += inflight_spans_.pendingSpans();
-      inflight_spans_.clear();
-
-      // If the buffer capacity has been changed, this is the place to resize
-      // it.
-      if (inflight_spans_.spanCapacity() != max_buffered_spans_) {
-        inflight_spans_.allocateBuffer(max_buffered_spans_);
-      }
-      write_cond_.notify_all();
+      transportInflightSpans();
     }
     auto now = std::chrono::steady_clock::now();
     due_time += reporting_period_;
     if (due_time < now)
       due_time = now;
   }
+  drainOnExit();
+}
+
+void ReporterImpl::transportInflightSpans() {
+  auto num_spans = inflight_spans_.pendingSpans();
+  auto num_dropped_before = transporter_->numSpansDropped();
+  transporter_->transportSpans(inflight_spans_);
+  num_spans_handed_off_ += num_spans;
+  if (!async_transport_) {
+    // Only the writer thread calls the transporter, so the spans it dropped
+    // since are from this batch.
+    auto num_dropped = std::min<uint64_t>(
+        transporter_->numSpansDropped() - num_dropped_before, num_spans);
+    num_spans_flushed_ += num_spans - num_dropped;
+    num_spans_unsent_ += num_dropped;
+  }
+  inflight_spans_.clear();
+
+  // If the buffer capacity has been changed, this is the place to resize
+  // it.
+  if (inflight_spans_.spanCapacity() != max_buffered_spans_) {
+    inflight_spans_.allocateBuffer(max_buffered_spans_);
+  }
+  notifyAll();
+}
+
+void ReporterImpl::drainOnExit() {
+  // Send what is left in batches until either nothing is left or the drain
+  // deadline passes. A batch that is being sent when the deadline passes is
+  // allowed to finish.
+  uint64_t num_drained = 0;
+  while (std::chrono::steady_clock::now() < drain_deadline_) {
+    spans_.drain(inflight_spans_);
+    if (inflight_spans_.pendingSpans() == 0) {
+      break;
+    }
+    num_drained += inflight_spans_.pendingSpans();
+    transportInflightSpans();
+  }
+  transporter_->flush(drain_deadline_);
+
+  // Spans still being sent by an asynchronous transporter are counted as
+  // abandoned.
+  auto num_abandoned = spans_.numPushed() - num_spans_flushed_ -
+                       num_spans_unsent_ - num_spans_evicted_;
+  num_spans_drained_ = num_drained;
+  num_spans_abandoned_ = num_abandoned;
+  if (num_abandoned > 0) {
+    std::cerr << "Zipkin reporter shut down with " << num_abandoned
+              << " spans unsent after sending " << num_drained
+              << " while draining\n";
+  }
+  if (drain_callback_) {
+    drain_callback_(stats());
+  }
 }
 } // namespace zipkin
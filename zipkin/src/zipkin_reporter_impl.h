@@ -7,6 +7,7 @@
 #include <mutex>
 #include <thread>
 
+#include "span_queue.h"
 #include "transporter.h"
 #include <zipkin/tracer.h>
 
@@ -15,6 +16,15 @@ namespace zipkin {
  * This class derives from the abstract zipkin::Reporter. It buffers spans and
  * relies on a Transporter to send spans to Zipkin.
  *
+ * Reported spans are pushed onto a sharded, lock-free SpanQueue that a writer
+ * thread drains, so reporting threads do not contend on a mutex. The writer is
+ * only woken early when a shard of the queue crosses its high-water mark, by
+ * number of spans or by memory. What happens to spans reported while the
+ * queue is full is determined by the OverflowPolicy.
+ *
+ * When the reporter is destroyed, spans still buffered are sent for up to the
+ * drain timeout. Any left after that are abandoned, and their number logged.
+ *
  * Up to `???` will be buffered. Spans are flushed
  * (sent to Zipkin) either when the buffer is full, or when a timer, set to
  * `????`, expires, whichever happens first.
@@ -34,7 +44,15 @@ public:
       size_t max_buffered_spans = DEFAULT_SPAN_BUFFER_SIZE);
 
   /**
-   * Destructor.
+   * Constructor.
+   *
+   * @param transporter The Transporter to be associated with the reporter.
+   * @param options The options that control how spans are buffered.
+   */
+  ReporterImpl(TransporterPtr &&transporter, const ReporterOptions &options);
+
+  /**
+   * Destructor. Sends the spans still buffered, for up to the drain timeout.
    */
   ~ReporterImpl();
 
@@ -47,25 +65,84 @@ public:
    */
   void reportSpan(const Span &span) override;
 
+  /**
+   * Implementation of zipkin::Reporter::reportSpan().
+   *
+   * Moves the given span onto the queue, and wakes the writer thread if the
+   * queue is filling up.
+   *
+   * @param span The span to be buffered.
+   */
+  void reportSpan(Span &&span) override;
+
+  /**
+   * Implementation of zipkin::Reporter::flushWithTimeout().
+   *
+   * Wakes the writer thread so that the spans reported so far are sent
+   * immediately, and waits until the transporter is done with them or the
+   * timeout expires.
+   *
+   * @param timeout The longest time to wait.
+   * @return true if the spans were sent before the timeout, or false if some
+   * were not sent, because of the timeout or because the transporter dropped
+   * them.
+   */
   bool flushWithTimeout(std::chrono::system_clock::duration timeout) override;
 
+  /**
+   * Implementation of zipkin::Reporter::stats().
+   */
+  ReporterStats stats() const override;
+
 private:
   TransporterPtr transporter_;
+  bool async_transport_;
 
   std::mutex write_mutex_;
   std::condition_variable write_cond_;
   SteadyClock::duration reporting_period_;
   size_t max_buffered_spans_;
+  OverflowPolicy overflow_policy_;
+  std::chrono::milliseconds overflow_block_timeout_;
+  std::chrono::milliseconds drain_timeout_;
+  std::function<void(const ReporterStats &)> drain_callback_;
 
   bool write_exit_ = false;
+  // The number of reported spans that a caller of flushWithTimeout() is
+  // waiting to be sent. Guarded by write_mutex_.
+  uint64_t flush_target_ = 0;
+  // Set by makeWriterExit().
+  SteadyTime drain_deadline_;
+  std::atomic<bool> wakeup_requested_{false};
   std::thread writer_;
-  int64_t num_spans_reported_ = 0;
-  std::atomic<int64_t> num_spans_flushed_{0};
-  SpanBuffer spans_;
+  std::atomic<uint64_t> num_spans_flushed_{0};
+  // Spans the transporter was given but didn't send.
+  std::atomic<uint64_t> num_spans_unsent_{0};
+  // Spans given to the transporter, which an asynchronous transporter may
+  // still be sending. Only used by the writer thread.
+  uint64_t num_spans_handed_off_ = 0;
+  // Spans rejected because the queue was full.
+  std::atomic<uint64_t> num_spans_rejected_{0};
+  // Queued spans discarded to make room for newer ones.
+  std::atomic<uint64_t> num_spans_evicted_{0};
+  // Set once the writer has drained the queue on exit.
+  std::atomic<uint64_t> num_spans_drained_{0};
+  std::atomic<uint64_t> num_spans_abandoned_{0};
+  SpanQueue spans_;
   SpanBuffer inflight_spans_;
 
+  void notifyAll();
+  bool isFlushed(uint64_t num_spans) const;
+  bool isSettled(uint64_t num_spans) const;
+  bool isHandedOff(uint64_t num_spans) const;
+  void wakeUpWriter();
+  bool pushDroppingOldest(Span &span);
+  bool pushBlocking(Span &span);
+
   void makeWriterExit();
   bool waitUntilNextReport(const SteadyTime &due_time);
   void writeReports();
+  void transportInflightSpans();
+  void drainOnExit();
 };
 } // namespace zipkin
@@ -0,0 +1,45 @@
+#include "zipkin_shm_transporter.h"
+
+#include "zipkin_reporter_impl.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace zipkin {
+ZipkinShmTransporter::ZipkinShmTransporter(
+    const SharedMemoryTransportOptions &options)
+    : ring_{options.name, options.ring_size, options.encoding},
+      encoder_{makeSpanEncoder(options.encoding)} {}
+
+void ZipkinShmTransporter::transportSpans(SpanBuffer &spans) {
+  auto num_spans = spans.pendingSpans();
+  if (num_spans == 0) {
+    return;
+  }
+  try {
+    body_.Clear();
+    spans.encode(*encoder_, body_);
+  } catch (const std::bad_alloc &) {
+    // Drop spans
+    num_spans_dropped_ += num_spans;
+    return;
+  }
+  if (!ring_.write(body_.GetString(), body_.GetSize(),
+                   static_cast<uint32_t>(num_spans))) {
+    num_spans_dropped_ += num_spans;
+  }
+}
+
+ReporterPtr
+makeSharedMemoryReporter(const SharedMemoryTransportOptions &transport_options,
+                         const ReporterOptions &reporter_options) try {
+  std::unique_ptr<Transporter> transporter{
+      new ZipkinShmTransporter{transport_options}};
+  std::unique_ptr<Reporter> reporter{
+      new ReporterImpl{std::move(transporter), reporter_options}};
+  return reporter;
+} catch (const std::runtime_error &error) {
+  std::cerr << error.what() << '\n';
+  return nullptr;
+}
+} // namespace zipkin
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "shm_span_ring.h"
+#include "span_encoder.h"
+#include "transporter.h"
+
+#include <atomic>
+
+namespace zipkin {
+/**
+ * This class derives from the abstract zipkin::Transporter. It hands spans to
+ * an exporter process through a ring buffer in shared memory, so that the
+ * processes of a multi-process server share one exporter, and one set of
+ * connections to the collector, instead of each sending spans itself.
+ *
+ * Each batch is encoded and written to the ring as one record. A batch that
+ * doesn't fit, because the exporter is not keeping up, is dropped and counted
+ * by numSpansDropped().
+ */
+class ZipkinShmTransporter : public Transporter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param options The options that control how spans are handed over.
+   *
+   * Throws std::runtime_error if the ring can't be opened.
+   */
+  explicit ZipkinShmTransporter(const SharedMemoryTransportOptions &options);
+
+  /**
+   * Implementation of zipkin::Transporter::transportSpans().
+   *
+   * @param spans The spans to be transported.
+   */
+  void transportSpans(SpanBuffer &spans) override;
+
+  /**
+   * Implementation of zipkin::Transporter::numSpansDropped().
+   */
+  uint64_t numSpansDropped() const override { return num_spans_dropped_; }
+
+private:
+  ShmSpanRing ring_;
+  SpanEncoderPtr encoder_;
+  // Kept across batches, so that once it has grown to the size of a typical
+  // batch, encoding does not allocate.
+  rapidjson::StringBuffer body_;
+  std::atomic<uint64_t> num_spans_dropped_{0};
+};
+} // namespace zipkin
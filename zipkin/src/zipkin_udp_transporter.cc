@@ -0,0 +1,164 @@
+#include "zipkin_udp_transporter.h"
+
+#include "zipkin_reporter_impl.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netdb.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace zipkin {
+// Room left at the end of each datagram for what endList() writes.
+static const size_t LIST_END_SIZE = 1;
+
+ZipkinUdpTransporter::ZipkinUdpTransporter(const UdpTransportOptions &options)
+    : max_datagram_size_{options.max_datagram_size},
+      encoder_{makeSpanEncoder(options.encoding)} {
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo *addresses;
+  auto rcode = getaddrinfo(options.collector_host.c_str(),
+                           std::to_string(options.collector_port).c_str(),
+                           &hints, &addresses);
+  if (rcode != 0) {
+    throw std::runtime_error{options.collector_host + ": " +
+                             gai_strerror(rcode)};
+  }
+  socket_ = socket(addresses->ai_family, SOCK_DGRAM, 0);
+  // Connecting a UDP socket only sets the address datagrams are sent to.
+  if (socket_ < 0 ||
+      connect(socket_, addresses->ai_addr, addresses->ai_addrlen) != 0) {
+    auto error = errno;
+    freeaddrinfo(addresses);
+    if (socket_ >= 0) {
+      close(socket_);
+    }
+    throw std::system_error{error, std::system_category()};
+  }
+  freeaddrinfo(addresses);
+  fcntl(socket_, F_SETFD, FD_CLOEXEC);
+  fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+}
+
+ZipkinUdpTransporter::~ZipkinUdpTransporter() { close(socket_); }
+
+bool ZipkinUdpTransporter::addSpan(const Span &span, Datagram &datagram) {
+  auto span_offset = body_.GetSize();
+  encoder_->addSpan(span);
+  if (body_.GetSize() - datagram.offset + LIST_END_SIZE > max_datagram_size_) {
+    body_.Pop(body_.GetSize() - span_offset);
+    return false;
+  }
+  ++datagram.num_spans;
+  return true;
+}
+
+void ZipkinUdpTransporter::encodeDatagrams(SpanBuffer &spans) {
+  body_.Clear();
+  datagrams_.clear();
+  Datagram datagram{0, 0, 0};
+  encoder_->startList(body_);
+  for (size_t i = 0; i < spans.pendingSpans(); ++i) {
+    const auto &span = spans.span(i);
+    if (addSpan(span, datagram)) {
+      continue;
+    }
+    if (datagram.num_spans > 0) {
+      // Close the datagram and start the next one with this span.
+      encoder_->endList();
+      datagram.size = body_.GetSize() - datagram.offset;
+      datagrams_.push_back(datagram);
+      datagram = Datagram{body_.GetSize(), 0, 0};
+      encoder_->startList(body_);
+      if (addSpan(span, datagram)) {
+        continue;
+      }
+    }
+    // The span doesn't fit in a datagram of its own. Restart the empty list,
+    // since the encoder has already counted the span as part of it.
+    ++num_spans_dropped_;
+    body_.Pop(body_.GetSize() - datagram.offset);
+    encoder_->startList(body_);
+  }
+  if (datagram.num_spans > 0) {
+    encoder_->endList();
+    datagram.size = body_.GetSize() - datagram.offset;
+    datagrams_.push_back(datagram);
+  }
+}
+
+size_t ZipkinUdpTransporter::sendDatagrams() {
+  // Once encoding is done, the body no longer moves.
+  auto data = const_cast<char *>(body_.GetString());
+  size_t num_sent = 0;
+#ifdef __linux__
+  std::vector<iovec> buffers(datagrams_.size());
+  std::vector<mmsghdr> messages(datagrams_.size());
+  for (size_t i = 0; i < datagrams_.size(); ++i) {
+    buffers[i].iov_base = data + datagrams_[i].offset;
+    buffers[i].iov_len = datagrams_[i].size;
+    std::memset(&messages[i], 0, sizeof(messages[i]));
+    messages[i].msg_hdr.msg_iov = &buffers[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  while (num_sent < messages.size()) {
+    auto result =
+        sendmmsg(socket_, &messages[num_sent],
+                 static_cast<unsigned>(messages.size() - num_sent), 0);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    num_sent += static_cast<size_t>(result);
+  }
+#else
+  for (; num_sent < datagrams_.size(); ++num_sent) {
+    const auto &datagram = datagrams_[num_sent];
+    if (send(socket_, data + datagram.offset, datagram.size, 0) < 0) {
+      break;
+    }
+  }
+#endif
+  if (num_sent < datagrams_.size() && errno != EAGAIN &&
+      errno != EWOULDBLOCK) {
+    std::cerr << "sendmmsg: " << std::strerror(errno) << '\n';
+  }
+  return num_sent;
+}
+
+void ZipkinUdpTransporter::transportSpans(SpanBuffer &spans) {
+  try {
+    encodeDatagrams(spans);
+  } catch (const std::bad_alloc &) {
+    // Drop spans
+    num_spans_dropped_ += spans.pendingSpans();
+    return;
+  }
+  // Datagrams the kernel couldn't take are dropped rather than retried.
+  for (auto i = sendDatagrams(); i < datagrams_.size(); ++i) {
+    num_spans_dropped_ += datagrams_[i].num_spans;
+  }
+}
+
+ReporterPtr makeUdpReporter(const UdpTransportOptions &transport_options,
+                            const ReporterOptions &reporter_options) try {
+  std::unique_ptr<Transporter> transporter{
+      new ZipkinUdpTransporter{transport_options}};
+  std::unique_ptr<Reporter> reporter{
+      new ReporterImpl{std::move(transporter), reporter_options}};
+  return reporter;
+} catch (const std::runtime_error &error) {
+  std::cerr << error.what() << '\n';
+  return nullptr;
+}
+} // namespace zipkin
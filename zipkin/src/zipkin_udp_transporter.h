@@ -0,0 +1,71 @@
+#pragma once
+
+#include "span_encoder.h"
+#include "transporter.h"
+
+#include <atomic>
+#include <vector>
+
+namespace zipkin {
+/**
+ * This class derives from the abstract zipkin::Transporter. It sends spans to
+ * a collector as UDP datagrams, without waiting for or retrying anything.
+ *
+ * Each batch is split into datagrams of up to max_datagram_size bytes, each
+ * holding a complete encoded list of spans, and all of them are sent with a
+ * single sendmmsg() call where it is available. The socket is non-blocking;
+ * datagrams the kernel can't take right away are dropped, as are spans that
+ * don't fit in a datagram on their own. Both are counted by
+ * numSpansDropped().
+ */
+class ZipkinUdpTransporter : public Transporter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param options The options that control how spans are sent.
+   *
+   * Throws std::runtime_error if the collector's address can't be resolved or
+   * the socket can't be created.
+   */
+  explicit ZipkinUdpTransporter(const UdpTransportOptions &options);
+
+  /**
+   * Destructor.
+   */
+  ~ZipkinUdpTransporter();
+
+  /**
+   * Implementation of zipkin::Transporter::transportSpans().
+   *
+   * @param spans The spans to be transported.
+   */
+  void transportSpans(SpanBuffer &spans) override;
+
+  /**
+   * Implementation of zipkin::Transporter::numSpansDropped().
+   */
+  uint64_t numSpansDropped() const override { return num_spans_dropped_; }
+
+private:
+  struct Datagram {
+    size_t offset;
+    size_t size;
+    size_t num_spans;
+  };
+
+  size_t max_datagram_size_;
+  SpanEncoderPtr encoder_;
+  int socket_ = -1;
+  std::atomic<uint64_t> num_spans_dropped_{0};
+
+  // The datagrams of a batch are encoded one after the other into body_.
+  // Both are kept across batches so that sending does not allocate.
+  rapidjson::StringBuffer body_;
+  std::vector<Datagram> datagrams_;
+
+  bool addSpan(const Span &span, Datagram &datagram);
+  void encodeDatagrams(SpanBuffer &spans);
+  size_t sendDatagrams();
+};
+} // namespace zipkin
@@ -0,0 +1,195 @@
+#include "zipkin_unix_socket_transporter.h"
+
+#include "zipkin_reporter_impl.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+// Platforms without MSG_NOSIGNAL use the SO_NOSIGPIPE socket option instead.
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace zipkin {
+static const size_t FRAME_HEADER_SIZE = 4;
+
+ZipkinUnixSocketTransporter::ZipkinUnixSocketTransporter(
+    const UnixSocketTransportOptions &options)
+    : socket_path_{options.socket_path}, write_timeout_{options.write_timeout},
+      encoder_{makeSpanEncoder(options.encoding)} {
+  if (socket_path_.empty() ||
+      socket_path_.size() >= sizeof(sockaddr_un{}.sun_path)) {
+    throw std::invalid_argument{"invalid Unix socket path: " + socket_path_};
+  }
+}
+
+ZipkinUnixSocketTransporter::~ZipkinUnixSocketTransporter() { disconnect(); }
+
+bool ZipkinUnixSocketTransporter::connect() {
+  socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_ < 0) {
+    std::cerr << "socket: " << std::strerror(errno) << '\n';
+    return false;
+  }
+  fcntl(socket_, F_SETFD, FD_CLOEXEC);
+  // A blocking connect() waits for as long as the agent's backlog is full,
+  // for instance while it is hung, so the socket is made non-blocking first.
+  fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+  int enable = 1;
+  setsockopt(socket_, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, socket_path_.c_str(), socket_path_.size());
+  if (::connect(socket_, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) == 0) {
+    return true;
+  }
+  // Linux fails with EAGAIN while the agent's backlog is full, and doesn't
+  // complete the connection later, so the agent is treated as unavailable.
+  // Other platforms may complete it asynchronously.
+  if (errno == EINPROGRESS && waitForConnection()) {
+    return true;
+  }
+  std::cerr << socket_path_ << ": " << std::strerror(errno) << '\n';
+  disconnect();
+  return false;
+}
+
+bool ZipkinUnixSocketTransporter::waitForConnection() {
+  pollfd poll_fd = {socket_, POLLOUT, 0};
+  auto result = poll(&poll_fd, 1, static_cast<int>(write_timeout_.count()));
+  if (result == 0) {
+    errno = ETIMEDOUT;
+    return false;
+  }
+  if (result < 0) {
+    return false;
+  }
+  int error = 0;
+  socklen_t error_size = sizeof(error);
+  if (getsockopt(socket_, SOL_SOCKET, SO_ERROR, &error, &error_size) != 0) {
+    return false;
+  }
+  errno = error;
+  return error == 0;
+}
+
+void ZipkinUnixSocketTransporter::disconnect() {
+  if (socket_ >= 0) {
+    close(socket_);
+    socket_ = -1;
+  }
+}
+
+bool ZipkinUnixSocketTransporter::writeFrame(size_t &num_written) {
+  auto body_size = body_.GetSize();
+  unsigned char header[FRAME_HEADER_SIZE] = {
+      static_cast<unsigned char>(body_size >> 24),
+      static_cast<unsigned char>(body_size >> 16),
+      static_cast<unsigned char>(body_size >> 8),
+      static_cast<unsigned char>(body_size)};
+  iovec buffers[2];
+  buffers[0].iov_base = header;
+  buffers[0].iov_len = FRAME_HEADER_SIZE;
+  buffers[1].iov_base = const_cast<char *>(body_.GetString());
+  buffers[1].iov_len = body_size;
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = buffers;
+  message.msg_iovlen = 2;
+
+  auto frame_size = FRAME_HEADER_SIZE + body_size;
+  auto deadline = SteadyClock::now() + write_timeout_;
+  num_written = 0;
+  while (num_written < frame_size) {
+    auto result = sendmsg(socket_, &message, MSG_NOSIGNAL);
+    if (result >= 0) {
+      num_written += static_cast<size_t>(result);
+      // Skip over what was written.
+      auto skip = static_cast<size_t>(result);
+      while (message.msg_iovlen > 0 && skip >= message.msg_iov->iov_len) {
+        skip -= message.msg_iov->iov_len;
+        ++message.msg_iov;
+        --message.msg_iovlen;
+      }
+      if (message.msg_iovlen > 0) {
+        message.msg_iov->iov_base =
+            static_cast<char *>(message.msg_iov->iov_base) + skip;
+        message.msg_iov->iov_len -= skip;
+      }
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      std::cerr << socket_path_ << ": " << std::strerror(errno) << '\n';
+      return false;
+    }
+    // The agent isn't keeping up; wait for room in the socket buffer.
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - SteadyClock::now());
+    pollfd poll_fd = {socket_, POLLOUT, 0};
+    if (timeout.count() <= 0 ||
+        poll(&poll_fd, 1, static_cast<int>(timeout.count())) == 0) {
+      std::cerr << socket_path_ << ": timed out writing spans\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+void ZipkinUnixSocketTransporter::transportSpans(SpanBuffer &spans) {
+  try {
+    body_.Clear();
+    spans.encode(*encoder_, body_);
+  } catch (const std::bad_alloc &) {
+    // Drop spans
+    num_spans_dropped_ += spans.pendingSpans();
+    return;
+  }
+
+  // A connection that was lost since the last batch is only noticed when
+  // writing to it, before any of the frame has been written. In that case,
+  // reconnect and try once more.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (socket_ < 0 && !connect()) {
+      break;
+    }
+    size_t num_written;
+    if (writeFrame(num_written)) {
+      return;
+    }
+    disconnect();
+    if (num_written > 0) {
+      break;
+    }
+  }
+  num_spans_dropped_ += spans.pendingSpans();
+}
+
+ReporterPtr makeUnixSocketReporter(
+    const UnixSocketTransportOptions &transport_options,
+    const ReporterOptions &reporter_options) try {
+  std::unique_ptr<Transporter> transporter{
+      new ZipkinUnixSocketTransporter{transport_options}};
+  std::unique_ptr<Reporter> reporter{
+      new ReporterImpl{std::move(transporter), reporter_options}};
+  return reporter;
+} catch (const std::invalid_argument &error) {
+  std::cerr << error.what() << '\n';
+  return nullptr;
+}
+} // namespace zipkin
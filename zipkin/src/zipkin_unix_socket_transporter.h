@@ -0,0 +1,71 @@
+#pragma once
+
+#include "span_encoder.h"
+#include "transporter.h"
+
+#include <atomic>
+#include <string>
+
+namespace zipkin {
+/**
+ * This class derives from the abstract zipkin::Transporter. It sends spans to
+ * a collector agent listening on a Unix domain socket, such as one running on
+ * the same node.
+ *
+ * Each batch is written as a frame: its size as a 4-byte big-endian integer,
+ * followed by the encoded spans. The socket is non-blocking; a frame that
+ * can't be written within the write timeout is abandoned, along with the
+ * connection. Part of that frame may already have been sent, so the agent must
+ * discard an incomplete frame at the end of a connection.
+ *
+ * The transporter connects on the first batch, and reconnects whenever the
+ * connection is lost, for instance because the agent was restarted. While the
+ * agent can't be reached, or isn't accepting connections, batches are
+ * dropped. Dropped spans are counted by
+ * numSpansDropped().
+ */
+class ZipkinUnixSocketTransporter : public Transporter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param options The options that control how spans are sent.
+   *
+   * Throws std::invalid_argument if the socket path is too long.
+   */
+  explicit ZipkinUnixSocketTransporter(
+      const UnixSocketTransportOptions &options);
+
+  /**
+   * Destructor.
+   */
+  ~ZipkinUnixSocketTransporter();
+
+  /**
+   * Implementation of zipkin::Transporter::transportSpans().
+   *
+   * @param spans The spans to be transported.
+   */
+  void transportSpans(SpanBuffer &spans) override;
+
+  /**
+   * Implementation of zipkin::Transporter::numSpansDropped().
+   */
+  uint64_t numSpansDropped() const override { return num_spans_dropped_; }
+
+private:
+  std::string socket_path_;
+  std::chrono::milliseconds write_timeout_;
+  SpanEncoderPtr encoder_;
+  // Kept across batches, so that once it has grown to the size of a typical
+  // batch, encoding does not allocate.
+  rapidjson::StringBuffer body_;
+  int socket_ = -1;
+  std::atomic<uint64_t> num_spans_dropped_{0};
+
+  bool connect();
+  bool waitForConnection();
+  void disconnect();
+  bool writeFrame(size_t &num_written);
+};
+} // namespace zipkin
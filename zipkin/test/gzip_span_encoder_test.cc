@@ -0,0 +1,56 @@
+#include "../src/gzip_span_encoder.h"
+#include "../src/span_buffer.h"
+#include "test_utility.h"
+
+#include <cstring>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static std::string encode(const SpanBuffer &spans, SpanEncoder &encoder) {
+  rapidjson::StringBuffer buffer;
+  spans.encode(encoder, buffer);
+  return std::string{buffer.GetString(), buffer.GetSize()};
+}
+
+TEST_CASE("gzip_span_encoder") {
+  Endpoint endpoint{"service", IpAddress{IpVersion::v4, "10.0.0.1", 80}};
+  SpanBuffer spans{1000};
+  for (int i = 0; i < 1000; ++i) {
+    Span span;
+    span.setTraceId(TraceId{0, 1});
+    span.setId(i + 1);
+    span.setName("operation");
+    span.addAnnotation(Annotation{100, "cs", endpoint});
+    span.addBinaryAnnotation(BinaryAnnotation{"http.method", "GET"});
+    spans.addSpan(span);
+  }
+
+  for (auto encoding :
+       {SpanEncoding::JSON_V1, SpanEncoding::JSON_V2, SpanEncoding::PROTO3}) {
+    auto expected = encode(spans, *makeSpanEncoder(encoding));
+    GzipSpanEncoder encoder{makeSpanEncoder(encoding), 6};
+    CHECK(std::strcmp(encoder.contentType(),
+                      makeSpanEncoder(encoding)->contentType()) == 0);
+
+    SECTION("The output decompresses to what the wrapped encoder writes.") {
+      auto compressed = encode(spans, encoder);
+      CHECK(gunzip(compressed) == expected);
+      CHECK(compressed.size() * 4 < expected.size());
+    }
+
+    SECTION("The encoder can be reused for successive lists.") {
+      auto first = encode(spans, encoder);
+      auto second = encode(spans, encoder);
+      CHECK(first == second);
+      CHECK(gunzip(second) == expected);
+    }
+  }
+
+  SECTION("An empty list compresses to a valid gzip stream.") {
+    SpanBuffer empty_spans{1};
+    GzipSpanEncoder encoder{makeSpanEncoder(SpanEncoding::JSON_V2), 1};
+    CHECK(gunzip(encode(empty_spans, encoder)) == "[]");
+  }
+}
@@ -0,0 +1,53 @@
+#include "../src/json_v1_encoder.h"
+#include "../src/span_buffer.h"
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static Span makeSpan() {
+  Span span;
+  span.setTraceId(TraceId{1, 2});
+  span.setName("abc");
+  span.setId(3);
+  span.setParentId(4);
+  span.setTimestamp(100);
+  span.setDuration(20);
+  Endpoint endpoint{"svc", IpAddress{}};
+  span.addAnnotation(Annotation{100, "cs", endpoint});
+  BinaryAnnotation string_tag{"lc", "svc"};
+  string_tag.setEndpoint(endpoint);
+  span.addBinaryAnnotation(std::move(string_tag));
+  BinaryAnnotation int_tag;
+  int_tag.setKey("n");
+  int_tag.setValue(int64_t{7});
+  span.addBinaryAnnotation(std::move(int_tag));
+  return span;
+}
+
+TEST_CASE("json_v1_encoder") {
+  auto span = makeSpan();
+  const std::string endpoint_json =
+      R"({"ipv4":"","port":0,"serviceName":"svc"})";
+  const std::string span_json =
+      R"({"traceId":"00000000000000010000000000000002","name":"abc",)"
+      R"("id":"0000000000000003","parentId":"0000000000000004",)"
+      R"("timestamp":100,"duration":20,)"
+      R"("annotations":[{"timestamp":100,"value":"cs","endpoint":)" +
+      endpoint_json +
+      R"(}],"binaryAnnotations":[{"key":"lc","value":"svc","endpoint":)" +
+      endpoint_json + R"(},{"key":"n","value":7,"type":"I64"}]})";
+
+  SECTION("Spans are serialized in a single pass.") {
+    CHECK(span.toJson() == span_json);
+  }
+
+  SECTION("A span buffer is serialized as an array of spans.") {
+    SpanBuffer buffer{2};
+    CHECK(buffer.toStringifiedJsonArray() == "[]");
+    buffer.addSpan(span);
+    buffer.addSpan(span);
+    CHECK(buffer.toStringifiedJsonArray() ==
+          "[" + span_json + "," + span_json + "]");
+  }
+}
@@ -0,0 +1,67 @@
+#include "../src/json_v1_encoder.h"
+#include "../src/json_v2_encoder.h"
+#include "../src/span_buffer.h"
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static std::string encode(SpanEncoder &encoder, const SpanBuffer &spans) {
+  rapidjson::StringBuffer buffer;
+  spans.encode(encoder, buffer);
+  return std::string{buffer.GetString(), buffer.GetSize()};
+}
+
+TEST_CASE("json_v2_encoder") {
+  Endpoint endpoint{"svc", IpAddress{IpVersion::v6, "::1", 80}};
+  Span span;
+  span.setTraceId(TraceId{0, 1});
+  span.setName("abc");
+  span.setId(2);
+  span.setTimestamp(100);
+  span.setDuration(20);
+  span.addAnnotation(Annotation{100, "cs", endpoint});
+  span.addAnnotation(Annotation{110, "retry", endpoint});
+  span.addAnnotation(Annotation{120, "cr", endpoint});
+  BinaryAnnotation local_component{"lc", "svc"};
+  local_component.setEndpoint(endpoint);
+  span.addBinaryAnnotation(std::move(local_component));
+  span.addBinaryAnnotation(BinaryAnnotation{"http.path", "/x"});
+  BinaryAnnotation int_tag;
+  int_tag.setKey("n");
+  int_tag.setValue(int64_t{-7});
+  span.addBinaryAnnotation(std::move(int_tag));
+
+  SECTION("Endpoints are only written once, as the local endpoint.") {
+    SpanBuffer spans{1};
+    spans.addSpan(span);
+    JsonV2Encoder encoder;
+    CHECK(encode(encoder, spans) ==
+          R"([{"traceId":"0000000000000001","id":"0000000000000002",)"
+          R"("kind":"CLIENT","name":"abc","timestamp":100,"duration":20,)"
+          R"("localEndpoint":{"serviceName":"svc","ipv6":"::1","port":80},)"
+          R"("annotations":[{"timestamp":110,"value":"retry"}],)"
+          R"("tags":{"http.path":"/x","n":"-7"}}])");
+  }
+
+  SECTION("The v2 encoding is more compact than v1.") {
+    SpanBuffer spans{1};
+    spans.addSpan(span);
+    JsonV1Encoder v1_encoder;
+    JsonV2Encoder v2_encoder;
+    CHECK(encode(v2_encoder, spans).size() * 2 <
+          encode(v1_encoder, spans).size());
+  }
+
+  SECTION("A list of spans is written as a JSON array.") {
+    SpanBuffer spans{2};
+    JsonV2Encoder encoder;
+    CHECK(encode(encoder, spans) == "[]");
+    Span minimal;
+    spans.addSpan(minimal);
+    spans.addSpan(minimal);
+    CHECK(encode(encoder, spans) ==
+          R"([{"traceId":"0000000000000000","id":"0000000000000000"},)"
+          R"({"traceId":"0000000000000000","id":"0000000000000000"}])");
+  }
+}
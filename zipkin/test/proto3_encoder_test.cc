@@ -0,0 +1,64 @@
+#include "../src/proto3_encoder.h"
+#include "../src/span_buffer.h"
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static std::string encode(const SpanBuffer &spans) {
+  rapidjson::StringBuffer buffer;
+  Proto3Encoder encoder;
+  spans.encode(encoder, buffer);
+  return std::string{buffer.GetString(), buffer.GetSize()};
+}
+
+static std::string bytes(std::initializer_list<unsigned char> values) {
+  return std::string{values.begin(), values.end()};
+}
+
+static const std::string trace_id_field =
+    bytes({0x0a, 0x08, 0, 0, 0, 0, 0, 0, 0, 1});
+static const std::string id_field = bytes({0x1a, 0x08, 0, 0, 0, 0, 0, 0, 0, 2});
+
+TEST_CASE("proto3_encoder") {
+  Span span;
+  span.setTraceId(TraceId{0, 1});
+  span.setId(2);
+
+  SECTION("An empty list encodes to nothing.") {
+    SpanBuffer spans{1};
+    CHECK(encode(spans).empty());
+  }
+
+  SECTION("Scalar fields are written in field order.") {
+    span.setName("a");
+    span.setTimestamp(100);
+    span.setDuration(20);
+    Endpoint endpoint{"s", IpAddress{}};
+    span.addAnnotation(Annotation{100, "cs", endpoint});
+    SpanBuffer spans{1};
+    spans.addSpan(span);
+    CHECK(encode(spans) ==
+          bytes({0x0a, 41}) + trace_id_field + id_field +
+              bytes({0x20, 0x01,                         // kind
+                     0x2a, 0x01, 'a',                    // name
+                     0x31, 100, 0, 0, 0, 0, 0, 0, 0,     // timestamp
+                     0x38, 20,                           // duration
+                     0x42, 0x03, 0x0a, 0x01, 's'}));     // local endpoint
+  }
+
+  SECTION("Endpoint addresses and tags are written as nested messages.") {
+    Endpoint endpoint{"s", IpAddress{IpVersion::v6, "::1", 80}};
+    span.addAnnotation(Annotation{100, "sr", endpoint});
+    span.addBinaryAnnotation(BinaryAnnotation{"k", "v"});
+    SpanBuffer spans{2};
+    spans.addSpan(span);
+    spans.addSpan(span);
+    auto encoded_span =
+        bytes({0x0a, 55}) + trace_id_field + id_field +
+        bytes({0x20, 0x02, 0x42, 23, 0x0a, 0x01, 's', 0x1a, 16, 0, 0, 0, 0, 0,
+               0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0x20, 80, 0x5a, 0x06, 0x0a,
+               0x01, 'k', 0x12, 0x01, 'v'});
+    CHECK(encode(spans) == encoded_span + encoded_span);
+  }
+}
@@ -0,0 +1,221 @@
+#include "../src/zipkin_reporter_impl.h"
+
+#include <ctime>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+namespace {
+// Holds up the writer thread until released, so that the reporter's queue
+// can be filled.
+class GatedTransporter : public Transporter {
+public:
+  void transportSpans(SpanBuffer &spans) override {
+    std::unique_lock<std::mutex> lock{mutex_};
+    cond_.wait(lock, [this] { return open_; });
+  }
+
+  void open() {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      open_ = true;
+    }
+    cond_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool open_ = false;
+};
+
+// Counts the spans sent into a counter that outlives the transporter.
+class CountingTransporter : public Transporter {
+public:
+  explicit CountingTransporter(uint64_t &num_spans_transported)
+      : num_spans_transported_(num_spans_transported) {}
+
+  void transportSpans(SpanBuffer &spans) override {
+    num_spans_transported_ += spans.pendingSpans();
+  }
+
+private:
+  uint64_t &num_spans_transported_;
+};
+
+// Sends spans asynchronously, reporting them sent, or dropped, only when
+// complete() is called.
+class DelayedTransporter : public Transporter {
+public:
+  void transportSpans(SpanBuffer &spans) override {
+    std::lock_guard<std::mutex> lock{mutex_};
+    num_pending_spans_ += spans.pendingSpans();
+  }
+
+  bool setCompletionCallback(TransportCallback callback) override {
+    callback_ = callback;
+    return true;
+  }
+
+  void complete(bool succeeded = true) {
+    size_t num_spans;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      num_spans = num_pending_spans_;
+      num_pending_spans_ = 0;
+    }
+    if (succeeded) {
+      callback_(num_spans, 0);
+    } else {
+      callback_(0, num_spans);
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  size_t num_pending_spans_ = 0;
+  TransportCallback callback_;
+};
+} // namespace
+
+static const int NUM_SPANS = 100;
+
+static ReporterOptions makeOptions(OverflowPolicy overflow_policy) {
+  ReporterOptions options;
+  options.reporting_period = std::chrono::hours{1};
+  options.max_buffered_spans = 10;
+  options.overflow_policy = overflow_policy;
+  options.overflow_block_timeout = std::chrono::milliseconds{1};
+  return options;
+}
+
+static void reportSpans(Reporter &reporter) {
+  for (int i = 0; i < NUM_SPANS; ++i) {
+    Span span;
+    span.setId(i);
+    reporter.reportSpan(std::move(span));
+  }
+}
+
+TEST_CASE("reporter_impl") {
+  auto transporter = new GatedTransporter{};
+  TransporterPtr transporter_ptr{transporter};
+
+  SECTION("Spans reported to a full buffer are dropped") {
+    ReporterImpl reporter{std::move(transporter_ptr),
+                          makeOptions(OverflowPolicy::DROP_NEWEST)};
+    reportSpans(reporter);
+    auto stats = reporter.stats();
+    CHECK(stats.spans_accepted + stats.spans_dropped == NUM_SPANS);
+    CHECK(stats.spans_dropped >= NUM_SPANS - 20);
+    transporter->open();
+  }
+
+  SECTION("The oldest spans are dropped to make room for new ones") {
+    ReporterImpl reporter{std::move(transporter_ptr),
+                          makeOptions(OverflowPolicy::DROP_OLDEST)};
+    reportSpans(reporter);
+    auto stats = reporter.stats();
+    CHECK(stats.spans_accepted == NUM_SPANS);
+    CHECK(stats.spans_dropped >= NUM_SPANS - 20);
+    transporter->open();
+    CHECK(reporter.flushWithTimeout(std::chrono::seconds{10}));
+    stats = reporter.stats();
+    CHECK(stats.spans_flushed + stats.spans_dropped == NUM_SPANS);
+  }
+
+  SECTION("Spans are dropped after blocking for the timeout") {
+    ReporterImpl reporter{std::move(transporter_ptr),
+                          makeOptions(OverflowPolicy::BLOCK)};
+    reportSpans(reporter);
+    CHECK(reporter.stats().spans_dropped > 0);
+    transporter->open();
+  }
+
+  SECTION("Blocking waits for the buffer to be flushed") {
+    auto options = makeOptions(OverflowPolicy::BLOCK);
+    options.overflow_block_timeout = std::chrono::seconds{10};
+    ReporterImpl reporter{std::move(transporter_ptr), options};
+    transporter->open();
+    reportSpans(reporter);
+    CHECK(reporter.flushWithTimeout(std::chrono::seconds{10}));
+    auto stats = reporter.stats();
+    CHECK(stats.spans_accepted == NUM_SPANS);
+    CHECK(stats.spans_dropped == 0);
+    CHECK(stats.spans_flushed == NUM_SPANS);
+  }
+
+  SECTION("Flushing sends buffered spans without waiting for the next report") {
+    ReporterImpl reporter{std::move(transporter_ptr),
+                          makeOptions(OverflowPolicy::DROP_NEWEST)};
+    transporter->open();
+    for (int i = 0; i < 3; ++i) {
+      reporter.reportSpan(Span{});
+    }
+    CHECK(reporter.flushWithTimeout(std::chrono::seconds{10}));
+    CHECK(reporter.stats().spans_flushed == 3);
+  }
+
+  SECTION("The writer sleeps while an asynchronous batch is being sent") {
+    auto delayed_transporter = new DelayedTransporter{};
+    ReporterImpl reporter{TransporterPtr{delayed_transporter},
+                          makeOptions(OverflowPolicy::DROP_NEWEST)};
+    reporter.reportSpan(Span{});
+    CHECK(!reporter.flushWithTimeout(std::chrono::milliseconds{100}));
+    auto cpu_start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds{500});
+    auto cpu_time = static_cast<double>(std::clock() - cpu_start) /
+                    CLOCKS_PER_SEC;
+    CHECK(cpu_time < 0.1);
+    delayed_transporter->complete();
+    CHECK(reporter.flushWithTimeout(std::chrono::seconds{10}));
+  }
+
+  SECTION("Flushing fails if the transporter drops the spans") {
+    auto delayed_transporter = new DelayedTransporter{};
+    ReporterImpl reporter{TransporterPtr{delayed_transporter},
+                          makeOptions(OverflowPolicy::DROP_NEWEST)};
+    reporter.reportSpan(Span{});
+    CHECK(!reporter.flushWithTimeout(std::chrono::milliseconds{100}));
+    delayed_transporter->complete(false);
+    CHECK(!reporter.flushWithTimeout(std::chrono::seconds{10}));
+    CHECK(reporter.stats().spans_flushed == 0);
+  }
+
+  SECTION("Buffered spans are sent when the reporter is destroyed") {
+    uint64_t num_spans_transported = 0;
+    ReporterStats drain_stats;
+    {
+      auto options = makeOptions(OverflowPolicy::DROP_NEWEST);
+      options.drain_callback = [&drain_stats](const ReporterStats &stats) {
+        drain_stats = stats;
+      };
+      ReporterImpl reporter{
+          TransporterPtr{new CountingTransporter{num_spans_transported}},
+          options};
+      for (int i = 0; i < 3; ++i) {
+        reporter.reportSpan(Span{});
+      }
+    }
+    CHECK(num_spans_transported == 3);
+    CHECK(drain_stats.spans_drained == 3);
+    CHECK(drain_stats.spans_abandoned == 0);
+  }
+
+  SECTION("Spans still being sent when draining ends are abandoned") {
+    ReporterStats drain_stats;
+    {
+      auto options = makeOptions(OverflowPolicy::DROP_NEWEST);
+      options.drain_timeout = std::chrono::milliseconds{100};
+      options.drain_callback = [&drain_stats](const ReporterStats &stats) {
+        drain_stats = stats;
+      };
+      ReporterImpl reporter{TransporterPtr{new DelayedTransporter{}}, options};
+      reporter.reportSpan(Span{});
+    }
+    CHECK(drain_stats.spans_drained == 1);
+    CHECK(drain_stats.spans_abandoned == 1);
+  }
+}
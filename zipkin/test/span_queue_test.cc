@@ -0,0 +1,118 @@
+#include "../src/span_queue.h"
+
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static Span makeSpan(uint64_t id) {
+  Span span;
+  span.setId(id);
+  span.setName("abc");
+  return span;
+}
+
+TEST_CASE("span_queue") {
+  SECTION("Spans can be pushed and drained") {
+    SpanQueue queue{4, 0, 1};
+    bool reached_high_water;
+    CHECK(queue.push(makeSpan(1), reached_high_water));
+    CHECK(!reached_high_water);
+    CHECK(queue.push(makeSpan(2), reached_high_water));
+    CHECK(reached_high_water);
+
+    SpanBuffer spans{10};
+    CHECK(queue.drain(spans) == 2);
+    CHECK(spans.pendingSpans() == 2);
+    CHECK(queue.numPushed() == 2);
+    CHECK(queue.drain(spans) == 0);
+  }
+
+  SECTION("Spans are rejected when the queue is full") {
+    SpanQueue queue{2, 0, 1};
+    bool reached_high_water;
+    CHECK(queue.push(makeSpan(1), reached_high_water));
+    CHECK(queue.push(makeSpan(2), reached_high_water));
+    CHECK(!queue.push(makeSpan(3), reached_high_water));
+    CHECK(reached_high_water);
+
+    SpanBuffer spans{10};
+    CHECK(queue.drain(spans) == 2);
+    CHECK(queue.push(makeSpan(4), reached_high_water));
+  }
+
+  SECTION("A full shard spills over into the other shards") {
+    SpanQueue queue{4, 0, 2};
+    bool reached_high_water;
+    for (int i = 0; i < 4; ++i) {
+      CHECK(queue.push(makeSpan(i), reached_high_water));
+    }
+    CHECK(!queue.push(makeSpan(4), reached_high_water));
+  }
+
+  SECTION("The memory budget bounds the queue") {
+    auto span_size = estimateMemorySize(makeSpan(1));
+    SpanQueue queue{100, 3 * span_size, 1};
+    bool reached_high_water;
+    CHECK(queue.push(makeSpan(1), reached_high_water));
+    CHECK(!reached_high_water);
+    CHECK(queue.push(makeSpan(2), reached_high_water));
+    CHECK(reached_high_water);
+    CHECK(queue.push(makeSpan(3), reached_high_water));
+    CHECK(!queue.push(makeSpan(4), reached_high_water));
+
+    SpanBuffer spans{100, 2 * span_size};
+    CHECK(queue.drain(spans) == 2);
+    CHECK(spans.isFull());
+    CHECK(queue.push(makeSpan(4), reached_high_water));
+  }
+
+  SECTION("A span over the memory budget is accepted by an empty queue") {
+    SpanQueue queue{100, 1, 1};
+    bool reached_high_water;
+    CHECK(queue.push(makeSpan(1), reached_high_water));
+    CHECK(!queue.push(makeSpan(2), reached_high_water));
+  }
+
+  SECTION("Draining stops when the buffer is full") {
+    SpanQueue queue{4, 0, 1};
+    bool reached_high_water;
+    for (int i = 0; i < 3; ++i) {
+      queue.push(makeSpan(i), reached_high_water);
+    }
+    SpanBuffer spans{2};
+    CHECK(queue.drain(spans) == 2);
+    spans.clear();
+    CHECK(queue.drain(spans) == 1);
+  }
+
+  SECTION("Spans pushed from many threads are all drained") {
+    const int num_threads = 4;
+    const int spans_per_thread = 1000;
+    SpanQueue queue{64, 0, num_threads};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      threads.emplace_back([&queue, i] {
+        bool reached_high_water;
+        for (int j = 0; j < spans_per_thread; ++j) {
+          while (!queue.push(makeSpan(i * spans_per_thread + j),
+                             reached_high_water)) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    SpanBuffer spans{16};
+    size_t num_drained = 0;
+    while (num_drained < num_threads * spans_per_thread) {
+      num_drained += queue.drain(spans);
+      spans.clear();
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    CHECK(num_drained == num_threads * spans_per_thread);
+    CHECK(queue.numPushed() == num_threads * spans_per_thread);
+  }
+}
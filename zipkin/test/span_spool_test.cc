@@ -0,0 +1,82 @@
+#include "../src/span_spool.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <system_error>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static const size_t MAX_BYTES = 8 * 64 * 1024;
+
+TEST_CASE("span_spool") {
+  char directory_template[] = "/tmp/span_spool_test.XXXXXX";
+  std::string directory = mkdtemp(directory_template);
+  std::string batch;
+  uint32_t num_spans;
+
+  SECTION("Batches are read back oldest first") {
+    SpanSpool spool{directory, MAX_BYTES};
+    CHECK(spool.empty());
+    // Enough batches to take several segments.
+    for (int i = 0; i < 40; ++i) {
+      auto data = std::to_string(i) + std::string(10000, 'x');
+      REQUIRE(spool.append(data.data(), data.size(), i));
+    }
+    for (int i = 0; i < 40; ++i) {
+      REQUIRE(spool.front(batch, num_spans));
+      CHECK(batch == std::to_string(i) + std::string(10000, 'x'));
+      CHECK(num_spans == static_cast<uint32_t>(i));
+      spool.pop();
+    }
+    CHECK(spool.empty());
+  }
+
+  SECTION("The spool is bounded") {
+    SpanSpool spool{directory, MAX_BYTES};
+    std::string data(10000, 'x');
+    int num_appended = 0;
+    while (spool.append(data.data(), data.size(), 1)) {
+      ++num_appended;
+    }
+    CHECK(num_appended * data.size() <= MAX_BYTES);
+    CHECK(num_appended * data.size() > MAX_BYTES / 2);
+
+    std::string too_large(MAX_BYTES, 'x');
+    spool.pop();
+    CHECK(!spool.append(too_large.data(), too_large.size(), 1));
+  }
+
+  SECTION("Batches are kept when the spool is reopened") {
+    {
+      SpanSpool spool{directory, MAX_BYTES};
+      spool.append("abc", 3, 1);
+      spool.append("def", 3, 2);
+      spool.pop();
+    }
+    SpanSpool spool{directory, MAX_BYTES};
+    REQUIRE(spool.front(batch, num_spans));
+    CHECK(batch == "def");
+    CHECK(num_spans == 2);
+  }
+
+  SECTION("Batches in another format are discarded when reopened") {
+    {
+      SpanSpool spool{directory, MAX_BYTES, 1};
+      spool.append("abc", 3, 1);
+    }
+    SpanSpool spool{directory, MAX_BYTES, 2};
+    CHECK(spool.empty());
+  }
+
+  SECTION("A spool can only be opened by one process at a time") {
+    SpanSpool spool{directory, MAX_BYTES};
+    CHECK_THROWS_AS((SpanSpool{directory, MAX_BYTES}),
+                    const std::system_error &);
+  }
+
+  std::system(("rm -rf " + directory).c_str());
+}
@@ -0,0 +1,159 @@
+#include "../src/tail_sampling_reporter.h"
+
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+namespace {
+// Records the IDs of the spans forwarded to it, into a vector that outlives
+// the reporter.
+class RecordingReporter : public Reporter {
+public:
+  RecordingReporter(std::mutex &mutex, std::vector<uint64_t> &span_ids)
+      : mutex_(mutex), span_ids_(span_ids) {}
+
+  void reportSpan(const Span &span) override {
+    std::lock_guard<std::mutex> lock{mutex_};
+    span_ids_.push_back(span.id());
+  }
+
+private:
+  std::mutex &mutex_;
+  std::vector<uint64_t> &span_ids_;
+};
+} // namespace
+
+static Span makeSpan(uint64_t trace_id, uint64_t id, bool is_root) {
+  Span span;
+  span.setTraceId(TraceId{trace_id});
+  span.setId(id);
+  if (!is_root) {
+    span.setParentId(trace_id);
+  }
+  span.setDuration(1000);
+  return span;
+}
+
+static BinaryAnnotation errorTag(bool value) {
+  BinaryAnnotation annotation;
+  annotation.setKey("error");
+  annotation.setValue(value);
+  return annotation;
+}
+
+static TailSamplingOptions makeOptions() {
+  TailSamplingOptions options;
+  options.sample_rate = 0.0;
+  options.latency_threshold = std::chrono::milliseconds{500};
+  return options;
+}
+
+TEST_CASE("tail_sampling_reporter") {
+  std::mutex mutex;
+  std::vector<uint64_t> span_ids;
+  auto forwardedSpans = [&] {
+    std::lock_guard<std::mutex> lock{mutex};
+    return span_ids;
+  };
+  ReporterPtr recorder{new RecordingReporter{mutex, span_ids}};
+
+  SECTION("Traces with an error are kept when their root finishes") {
+    TailSamplingReporter reporter{std::move(recorder), makeOptions()};
+    auto child = makeSpan(1, 2, false);
+    child.addBinaryAnnotation(errorTag(true));
+    reporter.reportSpan(std::move(child));
+    CHECK(forwardedSpans().empty());
+    reporter.reportSpan(makeSpan(1, 1, true));
+    CHECK(forwardedSpans() == (std::vector<uint64_t>{2, 1}));
+
+    // An error tag set to false doesn't count.
+    child = makeSpan(3, 4, false);
+    child.addBinaryAnnotation(errorTag(false));
+    reporter.reportSpan(std::move(child));
+    reporter.reportSpan(makeSpan(3, 3, true));
+    CHECK(forwardedSpans().size() == 2);
+
+    auto stats = reporter.stats();
+    CHECK(stats.traces_kept == 1);
+    CHECK(stats.traces_discarded == 1);
+  }
+
+  SECTION("Slow traces are kept") {
+    TailSamplingReporter reporter{std::move(recorder), makeOptions()};
+    auto root = makeSpan(1, 1, true);
+    root.setDuration(600000);
+    reporter.reportSpan(std::move(root));
+    CHECK(forwardedSpans().size() == 1);
+  }
+
+  SECTION("Other traces are kept at the base rate") {
+    auto options = makeOptions();
+    options.sample_rate = 1.0;
+    TailSamplingReporter reporter{std::move(recorder), options};
+    reporter.reportSpan(makeSpan(1, 1, true));
+    CHECK(forwardedSpans().size() == 1);
+  }
+
+  SECTION("Spans that finish after their trace was decided follow it") {
+    auto options = makeOptions();
+    options.decision_wait = std::chrono::milliseconds{50};
+    TailSamplingReporter reporter{std::move(recorder), options};
+    auto root = makeSpan(1, 1, true);
+    root.addBinaryAnnotation(errorTag(true));
+    reporter.reportSpan(std::move(root));
+    reporter.reportSpan(makeSpan(1, 2, false));
+    CHECK(forwardedSpans() == (std::vector<uint64_t>{1, 2}));
+
+    reporter.reportSpan(makeSpan(3, 3, true));
+    auto child = makeSpan(3, 4, false);
+    child.addBinaryAnnotation(errorTag(true));
+    reporter.reportSpan(std::move(child));
+    CHECK(forwardedSpans().size() == 2);
+
+    // Once the decision wait has passed, a late span starts a new trace.
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    reporter.reportSpan(makeSpan(1, 5, true));
+    CHECK(forwardedSpans().size() == 2);
+    auto stats = reporter.stats();
+    CHECK(stats.traces_kept == 1);
+    CHECK(stats.traces_discarded == 2);
+  }
+
+  SECTION("Traces whose root doesn't finish are decided after the wait") {
+    auto options = makeOptions();
+    options.decision_wait = std::chrono::milliseconds{50};
+    TailSamplingReporter reporter{std::move(recorder), options};
+    auto child = makeSpan(1, 2, false);
+    child.addBinaryAnnotation(BinaryAnnotation{"error", "timeout"});
+    reporter.reportSpan(std::move(child));
+    for (int i = 0; i < 500 && forwardedSpans().empty(); ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    CHECK(forwardedSpans().size() == 1);
+  }
+
+  SECTION("The oldest traces are decided early to stay within the budget") {
+    auto options = makeOptions();
+    options.max_buffered_bytes = 16 * 1024;
+    TailSamplingReporter reporter{std::move(recorder), options};
+    for (uint64_t trace_id = 1; trace_id <= 1000; ++trace_id) {
+      reporter.reportSpan(makeSpan(trace_id, trace_id, false));
+    }
+    auto stats = reporter.stats();
+    CHECK(stats.traces_evicted > 0);
+    CHECK(stats.traces_discarded == stats.traces_evicted);
+  }
+
+  SECTION("Flushing decides every trace held") {
+    TailSamplingReporter reporter{std::move(recorder), makeOptions()};
+    auto child = makeSpan(1, 2, false);
+    child.addBinaryAnnotation(errorTag(true));
+    reporter.reportSpan(std::move(child));
+    reporter.reportSpan(makeSpan(3, 4, false));
+    CHECK(reporter.flushWithTimeout(std::chrono::seconds{1}));
+    CHECK(forwardedSpans().size() == 1);
+    CHECK(reporter.stats().traces_discarded == 1);
+  }
+}
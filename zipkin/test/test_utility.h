@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../src/span_buffer.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+namespace zipkin {
+// Helpers shared by the tests; not part of the library.
+
+// Returns a buffer of spans with IDs counting from 1, all named "span".
+inline SpanBuffer makeSpans(int num_spans) {
+  SpanBuffer spans{static_cast<size_t>(num_spans)};
+  for (int i = 0; i < num_spans; ++i) {
+    Span span;
+    span.setId(i + 1);
+    span.setName("span");
+    spans.addSpan(std::move(span));
+  }
+  return spans;
+}
+
+// Decompresses a gzip stream, throwing if it is invalid, truncated or
+// followed by trailing data.
+inline std::string gunzip(const std::string &data) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+    throw std::runtime_error{"inflateInit2 failed"};
+  }
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  std::string result;
+  char buffer[4096];
+  int rcode;
+  do {
+    stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream.avail_out = sizeof(buffer);
+    rcode = inflate(&stream, Z_NO_FLUSH);
+    if (rcode != Z_OK && rcode != Z_STREAM_END) {
+      inflateEnd(&stream);
+      throw std::runtime_error{"invalid or truncated gzip stream"};
+    }
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (rcode != Z_STREAM_END);
+  auto num_trailing_bytes = stream.avail_in;
+  inflateEnd(&stream);
+  if (num_trailing_bytes != 0) {
+    throw std::runtime_error{"trailing data after the gzip stream"};
+  }
+  return result;
+}
+} // namespace zipkin
@@ -0,0 +1,118 @@
+#include "../src/zipkin_file_transporter.h"
+#include "test_utility.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csignal>
+
+#include <fstream>
+#include <zipkin/rapidjson/document.h>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static std::vector<std::string> readLines(const std::string &path) {
+  std::vector<std::string> result;
+  std::ifstream file{path};
+  std::string line;
+  while (std::getline(file, line)) {
+    result.push_back(line);
+  }
+  return result;
+}
+
+static bool exists(const std::string &path) {
+  return access(path.c_str(), F_OK) == 0;
+}
+
+TEST_CASE("zipkin_file_transporter") {
+  FileTransportOptions options;
+  options.path =
+      "/tmp/zipkin_file_transporter_test." + std::to_string(getpid());
+  auto removeFiles = [&options] {
+    unlink(options.path.c_str());
+    for (int i = 1; i <= 3; ++i) {
+      unlink((options.path + '.' + std::to_string(i)).c_str());
+    }
+  };
+  removeFiles();
+
+  SECTION("Each span is written as a line holding a JSON object") {
+    ZipkinFileTransporter transporter{options};
+    auto spans = makeSpans(3);
+    transporter.transportSpans(spans);
+    transporter.transportSpans(spans);
+    auto lines = readLines(options.path);
+    REQUIRE(lines.size() == 6);
+    for (auto &line : lines) {
+      rapidjson::Document document;
+      document.Parse(line.c_str());
+      REQUIRE(document.IsObject());
+      CHECK(document["name"] == "span");
+    }
+  }
+
+  SECTION("Files are rotated before they exceed the maximum size") {
+    options.max_file_size = 1;
+    options.max_rotated_files = 2;
+    ZipkinFileTransporter transporter{options};
+    auto spans = makeSpans(1);
+    for (int i = 0; i < 4; ++i) {
+      transporter.transportSpans(spans);
+    }
+    CHECK(readLines(options.path).size() == 1);
+    CHECK(readLines(options.path + ".1").size() == 1);
+    CHECK(readLines(options.path + ".2").size() == 1);
+    CHECK(!exists(options.path + ".3"));
+  }
+
+  SECTION("Only JSON encodings are supported") {
+    options.encoding = SpanEncoding::PROTO3;
+    CHECK(makeFileReporter(options, ReporterOptions{}) == nullptr);
+  }
+
+  SECTION("Batches that can't be written are counted as dropped") {
+    options.path = "/nonexistent/spans.json";
+    ZipkinFileTransporter transporter{options};
+    auto spans = makeSpans(2);
+    transporter.transportSpans(spans);
+    CHECK(transporter.numSpansDropped() == 2);
+  }
+
+  SECTION("Batches that are partly written are removed from the file") {
+    ZipkinFileTransporter transporter{options};
+    auto spans = makeSpans(1);
+    transporter.transportSpans(spans);
+    struct stat file_status;
+    REQUIRE(stat(options.path.c_str(), &file_status) == 0);
+
+    // Limit the file to half of another line, so that the write fails part
+    // way through the next batch.
+    auto line_size = static_cast<rlim_t>(file_status.st_size);
+    struct rlimit old_limit;
+    REQUIRE(getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+    auto old_handler = std::signal(SIGXFSZ, SIG_IGN);
+    auto limit = old_limit;
+    limit.rlim_cur = line_size + line_size / 2;
+    REQUIRE(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    auto batch = makeSpans(3);
+    transporter.transportSpans(batch);
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    std::signal(SIGXFSZ, old_handler);
+    CHECK(transporter.numSpansDropped() == 3);
+
+    transporter.transportSpans(spans);
+    auto lines = readLines(options.path);
+    REQUIRE(lines.size() == 2);
+    for (auto &line : lines) {
+      rapidjson::Document document;
+      document.Parse(line.c_str());
+      CHECK(document.IsObject());
+    }
+  }
+
+  removeFiles();
+}
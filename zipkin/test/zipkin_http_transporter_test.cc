@@ -0,0 +1,439 @@
+#include "../src/zipkin_http_transporter.h"
+#include "test_utility.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+namespace {
+// A minimal HTTP/1.1 server that accepts every POST, recording request bodies
+// and counting connections. It can be told to reject the next requests.
+class CollectorStub {
+public:
+  explicit CollectorStub(uint32_t port = 0) {
+    listener_ = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    bind(listener_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    socklen_t address_size = sizeof(address);
+    getsockname(listener_, reinterpret_cast<sockaddr *>(&address),
+                &address_size);
+    port_ = ntohs(address.sin_port);
+    listen(listener_, 16);
+    acceptor_ = std::thread(&CollectorStub::acceptConnections, this);
+  }
+
+  ~CollectorStub() {
+    shutdown(listener_, SHUT_RDWR);
+    close(listener_);
+    acceptor_.join();
+    for (auto &connection : connections_) {
+      connection.join();
+    }
+  }
+
+  uint32_t port() const { return port_; }
+
+  int numRequests() const { return num_requests_; }
+
+  std::string lastBody() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return last_body_;
+  }
+
+  std::string lastHeaders() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return last_headers_;
+  }
+
+  int numConnections() const { return num_connections_; }
+
+  // Responds to the next request with the given status line and headers,
+  // instead of accepting it.
+  void rejectNextRequest(const std::string &response) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    rejections_.push_back(response);
+  }
+
+private:
+  int listener_;
+  uint32_t port_;
+  std::thread acceptor_;
+  std::vector<std::thread> connections_;
+  std::atomic<int> num_requests_{0};
+  std::atomic<int> num_connections_{0};
+  std::mutex mutex_;
+  std::string last_body_;
+  std::string last_headers_;
+  std::vector<std::string> rejections_;
+
+  void acceptConnections() {
+    while (true) {
+      int connection = accept(listener_, nullptr, nullptr);
+      if (connection < 0) {
+        return;
+      }
+      ++num_connections_;
+      connections_.emplace_back(&CollectorStub::serve, this, connection);
+    }
+  }
+
+  void serve(int connection) {
+    std::string data;
+    char buffer[4096];
+    std::string body;
+    std::string headers;
+    while (true) {
+      auto header_end = data.find("\r\n\r\n");
+      if (header_end != std::string::npos &&
+          readBody(data, header_end + 4, headers, body)) {
+        std::string response = "HTTP/1.1 202 Accepted\r\n";
+        {
+          std::lock_guard<std::mutex> lock{mutex_};
+          last_headers_ = headers;
+          last_body_ = body;
+          if (!rejections_.empty()) {
+            response = rejections_.front();
+            rejections_.erase(rejections_.begin());
+          }
+        }
+        ++num_requests_;
+        response += "Content-Length: 0\r\n\r\n";
+        send(connection, response.data(), response.size(), 0);
+        continue;
+      }
+      auto size = recv(connection, buffer, sizeof(buffer), 0);
+      if (size <= 0) {
+        break;
+      }
+      data.append(buffer, static_cast<size_t>(size));
+    }
+    close(connection);
+  }
+
+  // Reads the body of the request at the start of data, and removes the
+  // request if it has been fully received.
+  static bool readBody(std::string &data, size_t body_start,
+                       std::string &headers, std::string &body) {
+    body.clear();
+    headers = data.substr(0, body_start);
+    if (headers.find("Transfer-Encoding: chunked") == std::string::npos) {
+      auto length_position = headers.find("Content-Length: ");
+      size_t content_length = std::stoul(headers.substr(length_position + 16));
+      if (data.size() < body_start + content_length) {
+        return false;
+      }
+      body = data.substr(body_start, content_length);
+      data.erase(0, body_start + content_length);
+      return true;
+    }
+    auto position = body_start;
+    while (true) {
+      auto size_end = data.find("\r\n", position);
+      if (size_end == std::string::npos) {
+        return false;
+      }
+      size_t chunk_size = std::stoul(data.substr(position), nullptr, 16);
+      auto chunk_end = size_end + 2 + chunk_size + 2;
+      if (data.size() < chunk_end) {
+        return false;
+      }
+      body.append(data, size_end + 2, chunk_size);
+      position = chunk_end;
+      if (chunk_size == 0) {
+        data.erase(0, position);
+        return true;
+      }
+    }
+  }
+};
+} // namespace
+
+static HttpTransportOptions makeOptions(const CollectorStub &collector) {
+  HttpTransportOptions options;
+  options.collector_host = "127.0.0.1";
+  options.collector_port = collector.port();
+  options.max_inflight_requests = 2;
+  return options;
+}
+
+TEST_CASE("zipkin_http_transporter") {
+  CollectorStub collector;
+  std::atomic<size_t> num_spans_sent{0};
+  std::atomic<size_t> num_spans_unsent{0};
+  auto count_spans = [&num_spans_sent, &num_spans_unsent](
+                         size_t num_spans, size_t num_spans_dropped) {
+    num_spans_sent += num_spans;
+    num_spans_unsent += num_spans_dropped;
+  };
+
+  SECTION("Batches are sent over connections that are kept open") {
+    ZipkinHttpTransporter transporter{makeOptions(collector)};
+    CHECK(transporter.setCompletionCallback(count_spans));
+    SpanBuffer spans{2};
+    for (int i = 0; i < 10; ++i) {
+      spans.addSpan(Span{});
+      spans.addSpan(Span{});
+      transporter.transportSpans(spans);
+      spans.clear();
+    }
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(num_spans_sent == 20);
+    CHECK(collector.numRequests() == 10);
+    CHECK(collector.numConnections() <= 2);
+  }
+
+  SECTION("Streamed bodies contain the whole batch") {
+    auto options = makeOptions(collector);
+    options.stream_request_body = true;
+    ZipkinHttpTransporter transporter{options};
+    transporter.setCompletionCallback(count_spans);
+
+    // Large enough to take several reads by libcurl.
+    const int num_spans = 2000;
+    SpanBuffer spans{num_spans};
+    for (int i = 0; i < num_spans; ++i) {
+      Span span;
+      span.setId(i);
+      span.setName("span-" + std::to_string(i));
+      span.addBinaryAnnotation(BinaryAnnotation{"key", "value"});
+      spans.addSpan(std::move(span));
+    }
+    auto expected_body = spans.toStringifiedJsonArray();
+    transporter.transportSpans(spans);
+    CHECK(spans.pendingSpans() == 0);
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(num_spans_sent == num_spans);
+    CHECK(collector.lastBody() == expected_body);
+  }
+
+  SECTION("Compressed bodies are gzipped whether or not they are streamed") {
+    for (auto stream_request_body : {false, true}) {
+      auto options = makeOptions(collector);
+      options.stream_request_body = stream_request_body;
+      options.compression_level = 6;
+      ZipkinHttpTransporter transporter{options};
+
+      SpanBuffer spans{500};
+      for (int i = 0; i < 500; ++i) {
+        Span span;
+        span.setId(i);
+        span.setName("span");
+        spans.addSpan(std::move(span));
+      }
+      auto expected_body = spans.toStringifiedJsonArray();
+      transporter.transportSpans(spans);
+      transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+      CHECK(collector.lastHeaders().find("Content-Encoding: gzip") !=
+            std::string::npos);
+      CHECK(gunzip(collector.lastBody()) == expected_body);
+    }
+  }
+
+  SECTION("Encoded spans are sent as they are") {
+    for (auto stream_request_body : {false, true}) {
+      auto options = makeOptions(collector);
+      options.stream_request_body = stream_request_body;
+      ZipkinHttpTransporter transporter{options};
+      transporter.setCompletionCallback(count_spans);
+      std::string body = "[{\"name\":\"encoded\"}]";
+      transporter.transportEncodedSpans(body.data(), body.size(), 1);
+      transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+      CHECK(collector.lastBody() == body);
+    }
+    CHECK(num_spans_sent == 2);
+  }
+
+  SECTION("Batches that fail are spooled and sent once the collector is back") {
+    char directory_template[] = "/tmp/zipkin_http_transporter_test.XXXXXX";
+    auto options = makeOptions(collector);
+    options.spool_directory = mkdtemp(directory_template);
+    {
+      // Nothing listens on the port while this is alive.
+      CollectorStub other_collector;
+      options.collector_port = other_collector.port();
+    }
+    // Declared first so that it outlives the transporter's connections.
+    std::unique_ptr<CollectorStub> restarted_collector;
+    ZipkinHttpTransporter transporter{options};
+    SpanBuffer spans{1};
+    spans.addSpan(Span{});
+    auto expected_body = spans.toStringifiedJsonArray();
+    transporter.transportSpans(spans);
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(transporter.numSpansDropped() == 0);
+
+    restarted_collector.reset(new CollectorStub{options.collector_port});
+    spans.addSpan(Span{});
+    transporter.transportSpans(spans);
+    for (int i = 0; i < 1000 && restarted_collector->numRequests() < 2; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    CHECK(restarted_collector->numRequests() == 2);
+    CHECK(restarted_collector->lastBody() == expected_body);
+    std::system(("rm -rf " + options.spool_directory).c_str());
+  }
+
+  SECTION("Batches are retried after the collector's Retry-After") {
+    for (auto stream_request_body : {false, true}) {
+      auto options = makeOptions(collector);
+      options.stream_request_body = stream_request_body;
+      ZipkinHttpTransporter transporter{options};
+      collector.rejectNextRequest(
+          "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\n");
+      auto num_requests = collector.numRequests();
+      SpanBuffer spans{1};
+      spans.addSpan(Span{});
+      auto expected_body = spans.toStringifiedJsonArray();
+      auto start_time = SteadyClock::now();
+      transporter.transportSpans(spans);
+      transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+      CHECK(SteadyClock::now() - start_time >= std::chrono::seconds{1});
+      CHECK(collector.numRequests() == num_requests + 2);
+      CHECK(collector.lastBody() == expected_body);
+      CHECK(transporter.numSpansDropped() == 0);
+    }
+  }
+
+  SECTION("Batches are dropped once they run out of retries") {
+    auto options = makeOptions(collector);
+    options.max_retries = 1;
+    options.retry_base_delay = std::chrono::milliseconds{1};
+    ZipkinHttpTransporter transporter{options};
+    transporter.setCompletionCallback(count_spans);
+    collector.rejectNextRequest("HTTP/1.1 500 Internal Server Error\r\n");
+    collector.rejectNextRequest("HTTP/1.1 500 Internal Server Error\r\n");
+    SpanBuffer spans{1};
+    spans.addSpan(Span{});
+    transporter.transportSpans(spans);
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(collector.numRequests() == 2);
+    CHECK(num_spans_sent == 0);
+    CHECK(num_spans_unsent == 1);
+    CHECK(transporter.numSpansDropped() == 1);
+  }
+
+  SECTION("Batches waiting for a request are dropped at the deadline") {
+    auto options = makeOptions(collector);
+    options.max_inflight_requests = 1;
+    ZipkinHttpTransporter transporter{options};
+    // The only request is held waiting to be retried.
+    collector.rejectNextRequest(
+        "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 60\r\n");
+    SpanBuffer spans{1};
+    spans.addSpan(Span{});
+    transporter.transportSpans(spans);
+    transporter.setDeadline(SteadyClock::now() +
+                            std::chrono::milliseconds{100});
+    auto start_time = SteadyClock::now();
+    spans.clear();
+    spans.addSpan(Span{});
+    transporter.transportSpans(spans);
+    CHECK(SteadyClock::now() - start_time < std::chrono::seconds{2});
+    CHECK(transporter.numSpansDropped() == 1);
+  }
+
+  SECTION("Batches the collector rejects outright are not retried") {
+    ZipkinHttpTransporter transporter{makeOptions(collector)};
+    collector.rejectNextRequest("HTTP/1.1 400 Bad Request\r\n");
+    SpanBuffer spans{1};
+    spans.addSpan(Span{});
+    transporter.transportSpans(spans);
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(collector.numRequests() == 1);
+    CHECK(transporter.numSpansDropped() == 1);
+  }
+
+  SECTION("Batches are spread across collectors") {
+    CollectorStub other_collector;
+    auto options = makeOptions(collector);
+    options.collector_urls = {
+        "http://127.0.0.1:" + std::to_string(collector.port()),
+        "http://127.0.0.1:" + std::to_string(other_collector.port()) + "/"};
+    ZipkinHttpTransporter transporter{options};
+    SpanBuffer spans{1};
+    for (int i = 0; i < 10; ++i) {
+      spans.addSpan(Span{});
+      transporter.transportSpans(spans);
+      spans.clear();
+    }
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(collector.numRequests() == 5);
+    CHECK(other_collector.numRequests() == 5);
+    CHECK(collector.lastHeaders().find("POST /api/v1/spans ") == 0);
+  }
+
+  SECTION("The spans of a trace are sent to the same collector") {
+    CollectorStub other_collector;
+    auto options = makeOptions(collector);
+    options.collector_urls = {
+        "http://127.0.0.1:" + std::to_string(collector.port()),
+        "http://127.0.0.1:" + std::to_string(other_collector.port())};
+    options.load_balancing_policy = LoadBalancingPolicy::TRACE_ID_HASH;
+    ZipkinHttpTransporter transporter{options};
+    transporter.setCompletionCallback(count_spans);
+    SpanBuffer spans{100};
+    for (int i = 0; i < 10; ++i) {
+      Span span;
+      span.setTraceId(TraceId{42});
+      spans.addSpan(std::move(span));
+      transporter.transportSpans(spans);
+      spans.clear();
+    }
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(collector.numRequests() + other_collector.numRequests() == 10);
+    CHECK(collector.numRequests() * other_collector.numRequests() == 0);
+
+    // A batch of many traces is split between the collectors.
+    for (int i = 0; i < 100; ++i) {
+      Span span;
+      span.setTraceId(TraceId{static_cast<uint64_t>(i + 1)});
+      span.setName("span");
+      spans.addSpan(std::move(span));
+    }
+    transporter.transportSpans(spans);
+    // The spans were moved to the batches of their collectors.
+    CHECK(spans.span(0).name().empty());
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(collector.numRequests() + other_collector.numRequests() == 12);
+    CHECK(num_spans_sent == 110);
+  }
+
+  SECTION("Batches are retried on another collector when one fails") {
+    uint32_t unused_port;
+    {
+      // Nothing listens on the port once this is destroyed.
+      CollectorStub other_collector;
+      unused_port = other_collector.port();
+    }
+    auto options = makeOptions(collector);
+    options.collector_urls = {
+        "http://127.0.0.1:" + std::to_string(unused_port),
+        "http://127.0.0.1:" + std::to_string(collector.port())};
+    options.retry_base_delay = std::chrono::milliseconds{1};
+    ZipkinHttpTransporter transporter{options};
+    SpanBuffer spans{1};
+    for (int i = 0; i < 10; ++i) {
+      spans.addSpan(Span{});
+      transporter.transportSpans(spans);
+      spans.clear();
+    }
+    transporter.flush(SteadyClock::now() + std::chrono::seconds{10});
+    CHECK(collector.numRequests() == 10);
+    CHECK(transporter.numSpansDropped() == 0);
+  }
+}
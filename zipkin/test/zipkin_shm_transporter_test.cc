@@ -0,0 +1,77 @@
+#include "../src/zipkin_shm_transporter.h"
+#include "test_utility.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+TEST_CASE("zipkin_shm_transporter") {
+  auto name = "/zipkin_shm_transporter_test." + std::to_string(getpid());
+  ShmSpanRing::remove(name);
+  std::string record;
+  uint32_t num_spans;
+
+  SECTION("Records wrap around the end of the ring") {
+    ShmSpanRing ring{name, 100, SpanEncoding::JSON_V1};
+    for (int i = 0; i < 20; ++i) {
+      auto data = std::string(30, static_cast<char>('a' + i));
+      REQUIRE(ring.write(data.data(), data.size(), i));
+      REQUIRE(ring.read(record, num_spans));
+      CHECK(record == data);
+      CHECK(num_spans == static_cast<uint32_t>(i));
+    }
+    CHECK(!ring.read(record, num_spans));
+  }
+
+  SECTION("Records that don't fit are dropped") {
+    ShmSpanRing ring{name, 100, SpanEncoding::JSON_V1};
+    std::string data(40, 'a');
+    CHECK(ring.write(data.data(), data.size(), 1));
+    CHECK(ring.write(data.data(), data.size(), 1));
+    CHECK(!ring.write(data.data(), data.size(), 1));
+    CHECK(ring.numRecordsDropped() == 1);
+  }
+
+  SECTION("A ring can only be shared by processes using the same encoding") {
+    ShmSpanRing ring{name, 100, SpanEncoding::JSON_V1};
+    CHECK_THROWS_AS((ShmSpanRing{name, 100, SpanEncoding::PROTO3}),
+                    const std::runtime_error &);
+  }
+
+  SECTION("Batches from other processes are read by the exporter") {
+    SharedMemoryTransportOptions options;
+    options.name = name;
+    options.ring_size = 1 << 20;
+    ShmSpanRing ring{name, options.ring_size, options.encoding};
+    auto spans = makeSpans(10);
+    auto expected_record = spans.toStringifiedJsonArray();
+
+    const int num_processes = 4;
+    for (int i = 0; i < num_processes; ++i) {
+      if (fork() == 0) {
+        ZipkinShmTransporter transporter{options};
+        auto child_spans = makeSpans(10);
+        transporter.transportSpans(child_spans);
+        _exit(transporter.numSpansDropped() == 0 ? 0 : 1);
+      }
+    }
+    for (int i = 0; i < num_processes; ++i) {
+      int status;
+      wait(&status);
+      CHECK(WIFEXITED(status));
+      CHECK(WEXITSTATUS(status) == 0);
+    }
+
+    for (int i = 0; i < num_processes; ++i) {
+      REQUIRE(ring.read(record, num_spans));
+      CHECK(record == expected_record);
+      CHECK(num_spans == 10);
+    }
+    CHECK(!ring.read(record, num_spans));
+  }
+
+  ShmSpanRing::remove(name);
+}
@@ -0,0 +1,115 @@
+#include "../src/zipkin_udp_transporter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <zipkin/rapidjson/document.h>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+namespace {
+// A UDP socket on the loopback interface that spans are sent to.
+class CollectorStub {
+public:
+  CollectorStub() {
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(socket_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    socklen_t address_size = sizeof(address);
+    getsockname(socket_, reinterpret_cast<sockaddr *>(&address),
+                &address_size);
+    port_ = ntohs(address.sin_port);
+  }
+
+  ~CollectorStub() { close(socket_); }
+
+  uint32_t port() const { return port_; }
+
+  // Returns the datagrams received so far.
+  std::vector<std::string> datagrams() {
+    std::vector<std::string> result;
+    static char buffer[65536];
+    pollfd poll_fd = {socket_, POLLIN, 0};
+    while (poll(&poll_fd, 1, 100) > 0) {
+      auto size = recv(socket_, buffer, sizeof(buffer), 0);
+      result.emplace_back(buffer, static_cast<size_t>(size));
+    }
+    return result;
+  }
+
+private:
+  int socket_;
+  uint32_t port_;
+};
+} // namespace
+
+static Span makeSpan(int id, size_t name_size) {
+  Span span;
+  span.setId(id);
+  span.setName(std::string(name_size, 'a'));
+  return span;
+}
+
+TEST_CASE("zipkin_udp_transporter") {
+  CollectorStub collector;
+  UdpTransportOptions options;
+  options.collector_host = "127.0.0.1";
+  options.collector_port = collector.port();
+  options.max_datagram_size = 1400;
+
+  SECTION("Batches are split into datagrams that each hold a list of spans") {
+    ZipkinUdpTransporter transporter{options};
+    SpanBuffer spans{100};
+    for (int i = 0; i < 100; ++i) {
+      spans.addSpan(makeSpan(i, 100));
+    }
+    transporter.transportSpans(spans);
+
+    auto datagrams = collector.datagrams();
+    CHECK(datagrams.size() > 1);
+    size_t num_spans = 0;
+    for (auto &datagram : datagrams) {
+      CHECK(datagram.size() <= options.max_datagram_size);
+      rapidjson::Document document;
+      document.Parse(datagram.c_str());
+      REQUIRE(document.IsArray());
+      num_spans += document.Size();
+    }
+    CHECK(num_spans == 100);
+    CHECK(transporter.numSpansDropped() == 0);
+  }
+
+  SECTION("Spans too large for a datagram are dropped and counted") {
+    ZipkinUdpTransporter transporter{options};
+    SpanBuffer spans{3};
+    spans.addSpan(makeSpan(1, 10));
+    spans.addSpan(makeSpan(2, 2000));
+    spans.addSpan(makeSpan(3, 10));
+    transporter.transportSpans(spans);
+
+    // The first span's datagram is sent when the second doesn't fit in it.
+    auto datagrams = collector.datagrams();
+    REQUIRE(datagrams.size() == 2);
+    for (auto &datagram : datagrams) {
+      rapidjson::Document document;
+      document.Parse(datagram.c_str());
+      REQUIRE(document.IsArray());
+      CHECK(document.Size() == 1);
+    }
+    CHECK(transporter.numSpansDropped() == 1);
+  }
+
+  SECTION("Unresolvable collectors are reported") {
+    options.collector_host = "collector.invalid";
+    CHECK(makeUdpReporter(options, ReporterOptions{}) == nullptr);
+  }
+}
@@ -0,0 +1,209 @@
+#include "../src/zipkin_unix_socket_transporter.h"
+#include "test_utility.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+namespace {
+// A collector agent that records the frames it receives on a Unix socket.
+class AgentStub {
+public:
+  explicit AgentStub(const std::string &path) : path_{path} {
+    unlink(path_.c_str());
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path_.c_str());
+    bind(listener_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    listen(listener_, 16);
+    acceptor_ = std::thread(&AgentStub::acceptConnections, this);
+  }
+
+  ~AgentStub() {
+    shutdown(listener_, SHUT_RDWR);
+    close(listener_);
+    acceptor_.join();
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      for (auto connection : connections_) {
+        shutdown(connection, SHUT_RDWR);
+      }
+    }
+    for (auto &reader : readers_) {
+      reader.join();
+    }
+    unlink(path_.c_str());
+  }
+
+  // Waits for the given number of frames to have been received.
+  std::vector<std::string> frames(size_t num_frames) {
+    for (int i = 0; i < 1000; ++i) {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (frames_.size() >= num_frames) {
+          return frames_;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    std::lock_guard<std::mutex> lock{mutex_};
+    return frames_;
+  }
+
+private:
+  std::string path_;
+  int listener_;
+  std::thread acceptor_;
+  std::vector<std::thread> readers_;
+  std::mutex mutex_;
+  std::vector<int> connections_;
+  std::vector<std::string> frames_;
+
+  void acceptConnections() {
+    while (true) {
+      int connection = accept(listener_, nullptr, nullptr);
+      if (connection < 0) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock{mutex_};
+      connections_.push_back(connection);
+      readers_.emplace_back(&AgentStub::readFrames, this, connection);
+    }
+  }
+
+  void readFrames(int connection) {
+    std::string data;
+    char buffer[4096];
+    while (true) {
+      auto size = recv(connection, buffer, sizeof(buffer), 0);
+      if (size <= 0) {
+        break;
+      }
+      data.append(buffer, static_cast<size_t>(size));
+      while (data.size() >= 4) {
+        auto bytes = reinterpret_cast<const unsigned char *>(data.data());
+        size_t frame_size = (size_t{bytes[0]} << 24) |
+                            (size_t{bytes[1]} << 16) |
+                            (size_t{bytes[2]} << 8) | size_t{bytes[3]};
+        if (data.size() < 4 + frame_size) {
+          break;
+        }
+        std::lock_guard<std::mutex> lock{mutex_};
+        frames_.push_back(data.substr(4, frame_size));
+        data.erase(0, 4 + frame_size);
+      }
+    }
+    close(connection);
+  }
+};
+} // namespace
+
+TEST_CASE("zipkin_unix_socket_transporter") {
+  UnixSocketTransportOptions options;
+  options.socket_path =
+      "/tmp/zipkin_unix_socket_transporter_test." + std::to_string(getpid());
+
+  SECTION("Batches are sent as length-prefixed frames") {
+    AgentStub agent{options.socket_path};
+    ZipkinUnixSocketTransporter transporter{options};
+    auto spans = makeSpans(2000);
+    auto expected_frame = spans.toStringifiedJsonArray();
+    transporter.transportSpans(spans);
+    transporter.transportSpans(spans);
+    auto frames = agent.frames(2);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[0] == expected_frame);
+    CHECK(frames[1] == expected_frame);
+  }
+
+  SECTION("The transporter reconnects when the agent restarts") {
+    ZipkinUnixSocketTransporter transporter{options};
+    auto spans = makeSpans(1);
+    {
+      AgentStub agent{options.socket_path};
+      transporter.transportSpans(spans);
+      CHECK(agent.frames(1).size() == 1);
+    }
+    // Batches sent while the agent is down are dropped.
+    transporter.transportSpans(spans);
+    CHECK(transporter.numSpansDropped() == 1);
+
+    AgentStub agent{options.socket_path};
+    transporter.transportSpans(spans);
+    CHECK(agent.frames(1).size() == 1);
+  }
+
+  SECTION("Batches that can't be written in time are dropped") {
+    // An agent that accepts connections but never reads from them.
+    unlink(options.socket_path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, options.socket_path.c_str());
+    bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    listen(listener, 16);
+
+    options.write_timeout = std::chrono::milliseconds{50};
+    ZipkinUnixSocketTransporter transporter{options};
+    auto spans = makeSpans(20000);
+    transporter.transportSpans(spans);
+    CHECK(transporter.numSpansDropped() == 20000);
+    close(listener);
+    unlink(options.socket_path.c_str());
+  }
+
+  SECTION("Batches are dropped while the agent's backlog is full") {
+    unlink(options.socket_path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, options.socket_path.c_str());
+    bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    listen(listener, 1);
+    // Fill the backlog of an agent that never accepts.
+    std::vector<int> clients;
+    for (int i = 0; i < 100; ++i) {
+      int client = socket(AF_UNIX, SOCK_STREAM, 0);
+      fcntl(client, F_SETFL, O_NONBLOCK);
+      clients.push_back(client);
+      if (connect(client, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0) {
+        break;
+      }
+    }
+
+    options.write_timeout = std::chrono::milliseconds{50};
+    ZipkinUnixSocketTransporter transporter{options};
+    auto spans = makeSpans(1);
+    auto start_time = SteadyClock::now();
+    transporter.transportSpans(spans);
+    CHECK(SteadyClock::now() - start_time < std::chrono::seconds{1});
+    CHECK(transporter.numSpansDropped() == 1);
+    for (auto client : clients) {
+      close(client);
+    }
+    close(listener);
+    unlink(options.socket_path.c_str());
+  }
+
+  SECTION("Socket paths that are too long are rejected") {
+    options.socket_path = std::string(200, 'a');
+    CHECK_THROWS_AS(ZipkinUnixSocketTransporter{options},
+                    const std::invalid_argument &);
+    CHECK(makeUnixSocketReporter(options, ReporterOptions{}) == nullptr);
+  }
+}
@@ -1,17 +1,52 @@
 #pragma once
 
+#include <map>
 #include <opentracing/tracer.h>
 #include <zipkin/ip_address.h>
 #include <zipkin/tracer.h>
 
 namespace zipkin {
+/**
+ * How the tracer decides whether to sample a new trace: with a fixed
+ * probability (sample_rate), up to a number of traces per second
+ * (max_traces_per_second), or with a probability per operation
+ * (operation_sample_rates, defaulting to sample_rate) and a minimum number of
+ * traces per second for each operation (min_traces_per_second).
+ */
+enum class SamplerType { PROBABILISTIC, RATE_LIMITING, PER_OPERATION };
+
 struct ZipkinOtTracerOptions {
   std::string collector_host = "localhost";
   uint32_t collector_port = 9411;
+  std::vector<std::string> collector_urls;
+  LoadBalancingPolicy load_balancing_policy = LoadBalancingPolicy::ROUND_ROBIN;
+  std::chrono::milliseconds collector_ejection_time =
+      DEFAULT_COLLECTOR_EJECTION_TIME;
   std::chrono::milliseconds collector_timeout = DEFAULT_TRANSPORT_TIMEOUT;
+  std::string collector_socket_path;
+  std::string collector_shm_name;
   SteadyClock::duration reporting_period = DEFAULT_REPORTING_PERIOD;
   size_t max_buffered_spans = DEFAULT_SPAN_BUFFER_SIZE;
+  size_t max_buffered_bytes = 0;
+  SpanEncoding encoding = SpanEncoding::JSON_V1;
+  size_t max_inflight_requests = DEFAULT_MAX_INFLIGHT_REQUESTS;
+  int compression_level = 0;
+  std::string spool_directory;
+  size_t spool_max_bytes = DEFAULT_SPOOL_MAX_BYTES;
+  int max_retries = DEFAULT_MAX_RETRIES;
+  std::chrono::milliseconds retry_base_delay = DEFAULT_RETRY_BASE_DELAY;
+  OverflowPolicy overflow_policy = OverflowPolicy::DROP_NEWEST;
+  std::chrono::milliseconds overflow_block_timeout =
+      DEFAULT_OVERFLOW_BLOCK_TIMEOUT;
+  std::chrono::milliseconds drain_timeout = DEFAULT_DRAIN_TIMEOUT;
+  SamplerType sampler_type = SamplerType::PROBABILISTIC;
   double sample_rate = 1.0;
+  double max_traces_per_second = 0.0;
+  std::map<std::string, double> operation_sample_rates;
+  double min_traces_per_second = 0.0;
+  size_t max_operations = 2000;
+  bool tail_sampling_enabled = false;
+  TailSamplingOptions tail_sampling;
 
   std::string service_name;
   IpAddress service_address;
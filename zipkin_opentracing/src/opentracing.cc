@@ -119,6 +119,7 @@ private:
   std::unordered_map<std::string, std::string> baggage_;
 
   friend class OtSpan;
+  friend class UnsampledOtSpan;
 };
 
 static const OtSpanContext *findSpanContext(
@@ -143,11 +144,10 @@ public:
 
     // Set IDs.
     span_->setId(RandomUtil::generateId());
+    // The trace ID of a root span was set when it was sampled.
     if (parent_span_context) {
       span_->setTraceId(parent_span_context->span_context_.trace_id());
       span_->setParentId(parent_span_context->span_context_.id());
-    } else {
-      span_->setTraceId(RandomUtil::generateId());
     }
 
     // Set timestamp.
@@ -288,6 +288,66 @@ private:
   SpanPtr span_;
 };
 
+// An unsampled span is never reported, so it only carries the context and
+// baggage needed to propagate the trace, and ignores everything else.
+class UnsampledOtSpan : public ot::Span {
+public:
+  UnsampledOtSpan(std::shared_ptr<const ot::Tracer> &&tracer_owner,
+                  const TraceId &trace_id,
+                  const OtSpanContext *parent_span_context)
+      : tracer_{std::move(tracer_owner)} {
+    if (parent_span_context) {
+      std::lock_guard<std::mutex> lock_guard{
+          parent_span_context->baggage_mutex_};
+      auto baggage = parent_span_context->baggage_;
+      zipkin::SpanContext span_context{
+          parent_span_context->span_context_.trace_id(),
+          RandomUtil::generateId(),
+          TraceId{parent_span_context->span_context_.id()}, 0};
+      span_context_ =
+          OtSpanContext{std::move(span_context), std::move(baggage)};
+    } else {
+      span_context_ = OtSpanContext{zipkin::SpanContext{
+          trace_id, RandomUtil::generateId(), Optional<TraceId>{}, 0}};
+    }
+  }
+
+  void
+  FinishWithOptions(const ot::FinishSpanOptions &options) noexcept override {}
+
+  void SetOperationName(string_view name) noexcept override {}
+
+  void SetTag(string_view key, const Value &value) noexcept override {}
+
+  void SetBaggageItem(string_view restricted_key,
+                      string_view value) noexcept override {
+    span_context_.setBaggageItem(restricted_key, value);
+  }
+
+  std::string BaggageItem(string_view restricted_key) const noexcept override {
+    return span_context_.baggageItem(restricted_key);
+  }
+
+  void Log(std::initializer_list<std::pair<string_view, Value>>
+               fields) noexcept override {}
+
+  void Log(SystemTime timestamp, std::initializer_list<std::pair<string_view, Value>>
+               fields) noexcept override {}
+
+  void Log(SystemTime timestamp, const std::vector<std::pair<string_view, Value>>&
+               fields) noexcept override {}
+
+  const ot::SpanContext &context() const noexcept override {
+    return span_context_;
+  }
+
+  const ot::Tracer &tracer() const noexcept override { return *tracer_; }
+
+private:
+  std::shared_ptr<const ot::Tracer> tracer_;
+  OtSpanContext span_context_;
+};
+
 class OtTracer : public ot::Tracer,
                  public std::enable_shared_from_this<OtTracer> {
 public:
@@ -300,20 +360,31 @@ public:
   StartSpanWithOptions(string_view operation_name,
                        const ot::StartSpanOptions &options) const
       noexcept override {
-
-    // Create the core zipkin span.
-    SpanPtr span{new zipkin::Span{}};
-    span->setName(operation_name);
-    span->setTracer(tracer_.get());
-
     auto parent = findSpanContext(options.references);
 
+    bool is_sampled;
+    TraceId trace_id;
     if (parent && parent->isValid()) {
-      span->setSampled(parent->isSampled());
+      is_sampled = parent->isSampled();
     } else {
-      span->setSampled(sampler_->ShouldSample());
+      // The trace ID is generated first, since samplers may decide from it.
+      trace_id = RandomUtil::generateId();
+      is_sampled = sampler_->ShouldSample(operation_name, trace_id);
+    }
+
+    // Skip building a core span that would never be reported.
+    if (!is_sampled) {
+      return std::unique_ptr<ot::Span>{
+          new UnsampledOtSpan{shared_from_this(), trace_id, parent}};
     }
 
+    // Create the core zipkin span.
+    SpanPtr span{new zipkin::Span{}};
+    span->setName(operation_name);
+    span->setTracer(tracer_.get());
+    span->setTraceId(trace_id);
+    span->setSampled(true);
+
     Endpoint endpoint{tracer_->serviceName(), tracer_->address()};
 
     // Add a binary annotation for the serviceName.
@@ -396,21 +467,72 @@ private:
   }
 };
 
+static SamplerPtr makeSampler(const ZipkinOtTracerOptions &options) {
+  switch (options.sampler_type) {
+  case SamplerType::RATE_LIMITING:
+    return SamplerPtr{new RateLimitingSampler{options.max_traces_per_second}};
+  case SamplerType::PER_OPERATION:
+    return SamplerPtr{new PerOperationSampler{
+        options.sample_rate, options.min_traces_per_second,
+        options.operation_sample_rates, options.max_operations}};
+  case SamplerType::PROBABILISTIC:
+    break;
+  }
+  return SamplerPtr{new ProbabilisticSampler{options.sample_rate}};
+}
+
 std::shared_ptr<opentracing::Tracer>
 makeZipkinOtTracer(const ZipkinOtTracerOptions &options,
                    std::unique_ptr<Reporter> &&reporter) {
   TracerPtr tracer{new Tracer{options.service_name, options.service_address}};
+  if (options.tail_sampling_enabled && reporter != nullptr) {
+    reporter = makeTailSamplingReporter(std::move(reporter),
+                                        options.tail_sampling);
+  }
   tracer->setReporter(std::move(reporter));
-  SamplerPtr sampler{new ProbabilisticSampler{options.sample_rate}};
+  auto sampler = makeSampler(options);
   return std::make_shared<OtTracer>(std::move(tracer), std::move(sampler));
 }
 
 std::shared_ptr<ot::Tracer>
 makeZipkinOtTracer(const ZipkinOtTracerOptions &options) {
-  auto reporter =
-      makeHttpReporter(options.collector_host.c_str(), options.collector_port,
-                       options.collector_timeout, options.reporting_period,
-                       options.max_buffered_spans);
+  ReporterOptions reporter_options;
+  reporter_options.reporting_period = options.reporting_period;
+  reporter_options.max_buffered_spans = options.max_buffered_spans;
+  reporter_options.max_buffered_bytes = options.max_buffered_bytes;
+  reporter_options.overflow_policy = options.overflow_policy;
+  reporter_options.overflow_block_timeout = options.overflow_block_timeout;
+  reporter_options.drain_timeout = options.drain_timeout;
+  if (!options.collector_shm_name.empty()) {
+    SharedMemoryTransportOptions transport_options;
+    transport_options.name = options.collector_shm_name;
+    transport_options.encoding = options.encoding;
+    auto reporter =
+        makeSharedMemoryReporter(transport_options, reporter_options);
+    return makeZipkinOtTracer(options, std::move(reporter));
+  }
+  if (!options.collector_socket_path.empty()) {
+    UnixSocketTransportOptions transport_options;
+    transport_options.socket_path = options.collector_socket_path;
+    transport_options.encoding = options.encoding;
+    auto reporter = makeUnixSocketReporter(transport_options, reporter_options);
+    return makeZipkinOtTracer(options, std::move(reporter));
+  }
+  HttpTransportOptions transport_options;
+  transport_options.collector_host = options.collector_host;
+  transport_options.collector_port = options.collector_port;
+  transport_options.collector_urls = options.collector_urls;
+  transport_options.load_balancing_policy = options.load_balancing_policy;
+  transport_options.collector_ejection_time = options.collector_ejection_time;
+  transport_options.collector_timeout = options.collector_timeout;
+  transport_options.encoding = options.encoding;
+  transport_options.max_inflight_requests = options.max_inflight_requests;
+  transport_options.compression_level = options.compression_level;
+  transport_options.spool_directory = options.spool_directory;
+  transport_options.spool_max_bytes = options.spool_max_bytes;
+  transport_options.max_retries = options.max_retries;
+  transport_options.retry_base_delay = options.retry_base_delay;
+  auto reporter = makeHttpReporter(transport_options, reporter_options);
   return makeZipkinOtTracer(options, std::move(reporter));
 }
 } // namespace zipkin
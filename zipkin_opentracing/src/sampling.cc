@@ -1,12 +1,157 @@
 #include "sampling.h"
-#include <random>
-#include <zipkin/randutils/randutils.h>
+#include <chrono>
+#include <cstring>
 
 namespace zipkin {
-std::mt19937_64 &getTlsRandomEngine();
+static const uint64_t TRACE_ID_MASK = (1ULL << 63) - 1;
 
-bool ProbabilisticSampler::ShouldSample() {
-  std::bernoulli_distribution dist(sample_rate_);
-  return dist(getTlsRandomEngine());
+ProbabilisticSampler::ProbabilisticSampler(double sample_rate) {
+  sample_rate = std::max(0.0, std::min(sample_rate, 1.0));
+  // 2^63 samples every trace, and is still exactly representable.
+  threshold_ = static_cast<uint64_t>(sample_rate * 9223372036854775808.0);
+}
+
+bool ProbabilisticSampler::ShouldSample(opentracing::string_view,
+                                        const TraceId &trace_id) {
+  return (trace_id.low() & TRACE_ID_MASK) < threshold_;
+}
+
+RateLimitingSampler::RateLimitingSampler(double max_traces_per_second) {
+  if (!(max_traces_per_second > 0.0)) {
+    return;
+  }
+  token_interval_ = std::max<int64_t>(
+      static_cast<int64_t>(1e9 / max_traces_per_second), 1);
+  bucket_interval_ = static_cast<int64_t>(
+      std::max(max_traces_per_second, 1.0) * token_interval_);
+}
+
+bool RateLimitingSampler::ShouldSample(opentracing::string_view,
+                                       const TraceId &) {
+  if (token_interval_ == 0) {
+    return false;
+  }
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+                 .count();
+  auto refill_time = refill_time_.load(std::memory_order_relaxed);
+  while (true) {
+    auto new_refill_time = std::max(refill_time, now) + token_interval_;
+    if (new_refill_time - now > bucket_interval_) {
+      return false;
+    }
+    if (refill_time_.compare_exchange_weak(refill_time, new_refill_time,
+                                           std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+}
+// FNV-1a, so that operation names can be hashed without copying them into a
+// std::string.
+static size_t hashOperationName(opentracing::string_view name) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash ^= static_cast<unsigned char>(name.data()[i]);
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+PerOperationSampler::Operation::Operation(opentracing::string_view name,
+                                          size_t hash, double sample_rate,
+                                          double min_traces_per_second)
+    : name{name.data(), name.size()}, hash{hash}, sampler{sample_rate},
+      lower_bound_sampler{min_traces_per_second} {}
+
+PerOperationSampler::PerOperationSampler(
+    double default_sample_rate, double min_traces_per_second,
+    std::map<std::string, double> operation_sample_rates,
+    size_t max_operations)
+    : default_sample_rate_{default_sample_rate},
+      min_traces_per_second_{min_traces_per_second},
+      max_operations_{max_operations}, default_sampler_{default_sample_rate} {
+  // Keep the table at most half full, so that probes stay short.
+  size_t capacity = 1;
+  while (capacity < 2 * (max_operations_ + operation_sample_rates.size())) {
+    capacity *= 2;
+  }
+  operations_.reset(new std::atomic<Operation *>[capacity]);
+  for (size_t i = 0; i < capacity; ++i) {
+    operations_[i].store(nullptr, std::memory_order_relaxed);
+  }
+  operations_mask_ = capacity - 1;
+
+  // Configured operations are added up front, so that they keep their rate
+  // however many other operations are added.
+  for (auto &operation_sample_rate : operation_sample_rates) {
+    const auto &name = operation_sample_rate.first;
+    auto hash = hashOperationName(name);
+    size_t i = hash & operations_mask_;
+    while (operations_[i].load(std::memory_order_relaxed) != nullptr) {
+      i = (i + 1) & operations_mask_;
+    }
+    operations_[i].store(new Operation{name, hash, operation_sample_rate.second,
+                                       min_traces_per_second_},
+                         std::memory_order_relaxed);
+  }
+}
+
+PerOperationSampler::~PerOperationSampler() {
+  for (size_t i = 0; i <= operations_mask_; ++i) {
+    delete operations_[i].load(std::memory_order_relaxed);
+  }
+}
+
+PerOperationSampler::Operation *
+PerOperationSampler::findOperation(opentracing::string_view name) {
+  auto hash = hashOperationName(name);
+  std::unique_ptr<Operation> new_operation;
+  for (size_t i = 0; i <= operations_mask_; ++i) {
+    auto &slot = operations_[(hash + i) & operations_mask_];
+    auto operation = slot.load(std::memory_order_acquire);
+    if (operation == nullptr) {
+      // Add the operation, unless the table is full or another thread adds
+      // an operation to the slot first.
+      if (new_operation == nullptr) {
+        if (num_operations_.fetch_add(1, std::memory_order_relaxed) >=
+            max_operations_) {
+          num_operations_.fetch_sub(1, std::memory_order_relaxed);
+          return nullptr;
+        }
+        new_operation.reset(new Operation{name, hash, default_sample_rate_,
+                                          min_traces_per_second_});
+      }
+      if (slot.compare_exchange_strong(operation, new_operation.get(),
+                                       std::memory_order_acq_rel)) {
+        return new_operation.release();
+      }
+    }
+    if (operation->hash == hash && operation->name.size() == name.size() &&
+        std::memcmp(operation->name.data(), name.data(), name.size()) == 0) {
+      if (new_operation != nullptr) {
+        num_operations_.fetch_sub(1, std::memory_order_relaxed);
+      }
+      return operation;
+    }
+  }
+  if (new_operation != nullptr) {
+    num_operations_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return nullptr;
+}
+
+bool PerOperationSampler::ShouldSample(opentracing::string_view operation_name,
+                                       const TraceId &trace_id) {
+  auto operation = findOperation(operation_name);
+  if (operation == nullptr) {
+    return default_sampler_.ShouldSample(operation_name, trace_id);
+  }
+  // Traces sampled by the rate count against the minimum too, so that the
+  // minimum only adds traces when the rate samples too few.
+  if (operation->sampler.ShouldSample(operation_name, trace_id)) {
+    operation->lower_bound_sampler.ShouldSample(operation_name, trace_id);
+    return true;
+  }
+  return operation->lower_bound_sampler.ShouldSample(operation_name, trace_id);
 }
 } // namespace zipkin
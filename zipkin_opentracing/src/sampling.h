@@ -1,23 +1,108 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <opentracing/string_view.h>
+#include <string>
+#include <zipkin/trace_id.h>
 
 namespace zipkin {
 class Sampler {
 public:
   virtual ~Sampler() = default;
-  virtual bool ShouldSample() = 0;
+  virtual bool ShouldSample(opentracing::string_view operation_name,
+                            const TraceId &trace_id) = 0;
 };
 
+/**
+ * Samples a trace if the low 63 bits of its ID are below a threshold computed
+ * from the sample rate. Trace IDs are random, so this samples the given
+ * fraction of traces without drawing a random number. Processes sampling at
+ * the same rate make the same decision for a trace, and those sampling at a
+ * lower rate sample a subset of the traces sampled at a higher one.
+ */
 class ProbabilisticSampler : public Sampler {
 public:
-  explicit ProbabilisticSampler(double sample_rate)
-      : sample_rate_(std::max(0.0, std::min(sample_rate, 1.0))){};
-  bool ShouldSample() override;
+  explicit ProbabilisticSampler(double sample_rate);
+  bool ShouldSample(opentracing::string_view operation_name,
+                    const TraceId &trace_id) override;
 
 private:
-  double sample_rate_;
+  uint64_t threshold_;
+};
+
+/**
+ * Samples up to a fixed number of traces per second, with bursts of up to a
+ * second's worth, or of one trace if less than one trace per second is
+ * sampled.
+ *
+ * The token bucket is kept as a single atomic: the time at which the bucket
+ * will have refilled completely (the generic cell rate algorithm). Sampling a
+ * trace pushes that time back by the time it takes to earn one token, and is
+ * refused if it would push it back beyond a full bucket. ShouldSample() can
+ * therefore be called from any thread without taking a lock.
+ */
+class RateLimitingSampler : public Sampler {
+public:
+  explicit RateLimitingSampler(double max_traces_per_second);
+  bool ShouldSample(opentracing::string_view operation_name,
+                    const TraceId &trace_id) override;
+
+private:
+  // In nanoseconds of the steady clock.
+  int64_t token_interval_ = 0;
+  int64_t bucket_interval_ = 0;
+  std::atomic<int64_t> refill_time_{0};
+};
+
+/**
+ * Samples each operation with a rate of its own, and guarantees each a
+ * minimum number of traces per second, so that rare operations are sampled
+ * even while frequent ones use up most of the traces.
+ *
+ * Operations are kept in a fixed-size, open-addressing hash table of atomic
+ * pointers. Operations are added on first use and never removed, so looking
+ * up a known operation only takes atomic loads. Operations with a configured
+ * rate are added up front and don't count against max_operations. Once
+ * max_operations others have been added, further operations are sampled at
+ * the default rate, without a minimum.
+ */
+class PerOperationSampler : public Sampler {
+public:
+  PerOperationSampler(double default_sample_rate, double min_traces_per_second,
+                      std::map<std::string, double> operation_sample_rates,
+                      size_t max_operations);
+  ~PerOperationSampler();
+
+  PerOperationSampler(const PerOperationSampler &) = delete;
+  PerOperationSampler &operator=(const PerOperationSampler &) = delete;
+
+  bool ShouldSample(opentracing::string_view operation_name,
+                    const TraceId &trace_id) override;
+
+private:
+  struct Operation {
+    Operation(opentracing::string_view name, size_t hash, double sample_rate,
+              double min_traces_per_second);
+
+    std::string name;
+    size_t hash;
+    ProbabilisticSampler sampler;
+    RateLimitingSampler lower_bound_sampler;
+  };
+
+  double default_sample_rate_;
+  double min_traces_per_second_;
+  size_t max_operations_;
+  ProbabilisticSampler default_sampler_;
+  std::unique_ptr<std::atomic<Operation *>[]> operations_;
+  size_t operations_mask_;
+  std::atomic<size_t> num_operations_{0};
+
+  Operation *findOperation(opentracing::string_view name);
 };
 
 typedef std::unique_ptr<Sampler> SamplerPtr;
-} // namespace zipkin
\ No newline at end of file
+} // namespace zipkin
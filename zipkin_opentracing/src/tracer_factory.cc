@@ -52,10 +52,37 @@ OtTracerFactory::MakeTracer(const char *configuration,
   if (document.HasMember("collector_port")) {
     options.collector_port = document["collector_port"].GetInt();
   }
+  if (document.HasMember("collector_urls")) {
+    for (const auto &collector_url : document["collector_urls"].GetArray()) {
+      options.collector_urls.emplace_back(collector_url.GetString());
+    }
+  }
+  if (document.HasMember("load_balancing_policy")) {
+    std::string load_balancing_policy =
+        document["load_balancing_policy"].GetString();
+    if (load_balancing_policy == "least_outstanding") {
+      options.load_balancing_policy = LoadBalancingPolicy::LEAST_OUTSTANDING;
+    } else if (load_balancing_policy == "trace_id_hash") {
+      options.load_balancing_policy = LoadBalancingPolicy::TRACE_ID_HASH;
+    } else {
+      options.load_balancing_policy = LoadBalancingPolicy::ROUND_ROBIN;
+    }
+  }
+  if (document.HasMember("collector_ejection_time")) {
+    options.collector_ejection_time =
+        std::chrono::milliseconds{document["collector_ejection_time"].GetInt()};
+  }
   if (document.HasMember("collector_timeout")) {
     options.collector_timeout =
             std::chrono::milliseconds{document["collector_timeout"].GetInt()};
   }
+  if (document.HasMember("collector_socket_path")) {
+    options.collector_socket_path =
+        document["collector_socket_path"].GetString();
+  }
+  if (document.HasMember("collector_shm_name")) {
+    options.collector_shm_name = document["collector_shm_name"].GetString();
+  }
   if (document.HasMember("reporting_period")) {
     options.reporting_period =
         std::chrono::microseconds{document["reporting_period"].GetInt()};
@@ -63,9 +90,111 @@ OtTracerFactory::MakeTracer(const char *configuration,
   if (document.HasMember("max_buffered_spans")) {
     options.max_buffered_spans = document["max_buffered_spans"].GetInt();
   }
+  if (document.HasMember("max_buffered_bytes")) {
+    options.max_buffered_bytes = document["max_buffered_bytes"].GetUint64();
+  }
+  if (document.HasMember("encoding")) {
+    std::string encoding = document["encoding"].GetString();
+    if (encoding == "json_v2") {
+      options.encoding = SpanEncoding::JSON_V2;
+    } else if (encoding == "proto3") {
+      options.encoding = SpanEncoding::PROTO3;
+    } else {
+      options.encoding = SpanEncoding::JSON_V1;
+    }
+  }
+  if (document.HasMember("max_inflight_requests")) {
+    options.max_inflight_requests = document["max_inflight_requests"].GetInt();
+  }
+  if (document.HasMember("compression_level")) {
+    options.compression_level = document["compression_level"].GetInt();
+  }
+  if (document.HasMember("spool_directory")) {
+    options.spool_directory = document["spool_directory"].GetString();
+  }
+  if (document.HasMember("spool_max_bytes")) {
+    options.spool_max_bytes = document["spool_max_bytes"].GetUint64();
+  }
+  if (document.HasMember("max_retries")) {
+    options.max_retries = document["max_retries"].GetInt();
+  }
+  if (document.HasMember("retry_base_delay")) {
+    options.retry_base_delay =
+        std::chrono::milliseconds{document["retry_base_delay"].GetInt()};
+  }
+  if (document.HasMember("overflow_policy")) {
+    std::string overflow_policy = document["overflow_policy"].GetString();
+    if (overflow_policy == "drop_oldest") {
+      options.overflow_policy = OverflowPolicy::DROP_OLDEST;
+    } else if (overflow_policy == "block") {
+      options.overflow_policy = OverflowPolicy::BLOCK;
+    } else {
+      options.overflow_policy = OverflowPolicy::DROP_NEWEST;
+    }
+  }
+  if (document.HasMember("overflow_block_timeout")) {
+    options.overflow_block_timeout =
+        std::chrono::milliseconds{document["overflow_block_timeout"].GetInt()};
+  }
+  if (document.HasMember("drain_timeout")) {
+    options.drain_timeout =
+        std::chrono::milliseconds{document["drain_timeout"].GetInt()};
+  }
   if (document.HasMember("sample_rate")) {
     options.sample_rate = document["sample_rate"].GetDouble();
   }
+  if (document.HasMember("sampler")) {
+    const auto &sampler = document["sampler"];
+    std::string sampler_type = sampler["type"].GetString();
+    if (sampler_type == "ratelimiting") {
+      options.sampler_type = SamplerType::RATE_LIMITING;
+    } else if (sampler_type == "peroperation") {
+      options.sampler_type = SamplerType::PER_OPERATION;
+    } else {
+      options.sampler_type = SamplerType::PROBABILISTIC;
+    }
+    if (sampler.HasMember("sample_rate")) {
+      options.sample_rate = sampler["sample_rate"].GetDouble();
+    }
+    if (sampler.HasMember("max_traces_per_second")) {
+      options.max_traces_per_second =
+          sampler["max_traces_per_second"].GetDouble();
+    }
+    if (sampler.HasMember("operation_sample_rates")) {
+      for (const auto &operation :
+           sampler["operation_sample_rates"].GetObject()) {
+        options.operation_sample_rates[operation.name.GetString()] =
+            operation.value.GetDouble();
+      }
+    }
+    if (sampler.HasMember("min_traces_per_second")) {
+      options.min_traces_per_second =
+          sampler["min_traces_per_second"].GetDouble();
+    }
+    if (sampler.HasMember("max_operations")) {
+      options.max_operations = sampler["max_operations"].GetUint64();
+    }
+  }
+  if (document.HasMember("tail_sampling")) {
+    const auto &tail_sampling = document["tail_sampling"];
+    options.tail_sampling_enabled = true;
+    if (tail_sampling.HasMember("decision_wait")) {
+      options.tail_sampling.decision_wait =
+          std::chrono::milliseconds{tail_sampling["decision_wait"].GetInt()};
+    }
+    if (tail_sampling.HasMember("latency_threshold")) {
+      options.tail_sampling.latency_threshold = std::chrono::milliseconds{
+          tail_sampling["latency_threshold"].GetInt()};
+    }
+    if (tail_sampling.HasMember("sample_rate")) {
+      options.tail_sampling.sample_rate =
+          tail_sampling["sample_rate"].GetDouble();
+    }
+    if (tail_sampling.HasMember("max_buffered_bytes")) {
+      options.tail_sampling.max_buffered_bytes =
+          tail_sampling["max_buffered_bytes"].GetUint64();
+    }
+  }
   return makeZipkinOtTracer(options);
 } catch (const std::bad_alloc &) {
   return opentracing::make_unexpected(
@@ -9,6 +9,11 @@ namespace zipkin {
 class InMemoryReporter : public Reporter {
 public:
   void reportSpan(const Span &span) override {
+    std::lock_guard<std::mutex> lock_guard(mutex_);
+    spans_.emplace_back(span);
+  }
+
+  void reportSpan(Span &&span) override {
     std::lock_guard<std::mutex> lock_guard(mutex_);
     spans_.emplace_back(std::move(span));
   }
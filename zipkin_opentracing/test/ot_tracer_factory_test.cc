@@ -44,6 +44,99 @@ TEST_CASE("OtTracerFactory") {
     CHECK(tracer_maybe);
   }
 
+  SECTION("Constructing tracer with a rate-limiting sampler") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "sampler": {
+        "type": "ratelimiting",
+        "max_traces_per_second": 100
+      }
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message == "");
+    CHECK(tracer_maybe);
+  }
+
+  SECTION("Constructing tracer with a per-operation sampler") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "sampler": {
+        "type": "peroperation",
+        "sample_rate": 0.01,
+        "min_traces_per_second": 1,
+        "operation_sample_rates": {
+          "checkout": 0.5
+        }
+      }
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message == "");
+    CHECK(tracer_maybe);
+  }
+
+  SECTION("Constructing tracer with tail sampling") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "tail_sampling": {
+        "latency_threshold": 500,
+        "sample_rate": 0.01
+      }
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message == "");
+    CHECK(tracer_maybe);
+  }
+
+  SECTION("Constructing a tracer with an unknown sampler fails.") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "sampler": {
+        "type": "sometimes"
+      }
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message != "");
+    CHECK(!tracer_maybe);
+  }
+
+  SECTION("Constructing a tracer with an unknown encoding fails.") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "encoding": "xml"
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message != "");
+    CHECK(!tracer_maybe);
+  }
+
+  SECTION("Constructing tracer with the v2 encoding") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "encoding": "json_v2"
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message == "");
+    CHECK(tracer_maybe);
+  }
+
+  SECTION("Constructing tracer with an overflow policy") {
+    const char *configuration = R"(
+    {
+      "service_name": "abc",
+      "overflow_policy": "block",
+      "overflow_block_timeout": 50
+    })";
+    auto tracer_maybe = tracer_factory.MakeTracer(configuration, error_message);
+    CHECK(error_message == "");
+    CHECK(tracer_maybe);
+  }
+
   SECTION("Constructing a tracer from a valid configuration succeeds.") {
     const char *configuration = R"(
     {
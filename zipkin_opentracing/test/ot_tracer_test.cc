@@ -2,6 +2,7 @@
 #include "../src/utility.h"
 #include "in_memory_reporter.h"
 #include <algorithm>
+#include <map>
 #include <stdexcept>
 #include <opentracing/noop.h>
 #include <zipkin/opentracing.h>
@@ -35,6 +36,18 @@ static bool hasTag(const Span &span, ot::string_view key, ot::Value value) {
       });
 }
 
+namespace {
+struct TextMapCarrier : ot::TextMapWriter {
+  ot::expected<void> Set(ot::string_view key,
+                         ot::string_view value) const override {
+    text_map[key] = value;
+    return {};
+  }
+
+  mutable std::map<std::string, std::string> text_map;
+};
+} // namespace
+
 static bool IsChildOf(const zipkin::Span &a, const zipkin::Span &b) {
   return a.isSetParentId() && a.parentId() == b.id() &&
          a.traceId() == b.traceId();
@@ -98,6 +111,28 @@ TEST_CASE("ot_tracer") {
     CHECK(r2->spans().empty());
   }
 
+  SECTION("Unsampled spans still propagate their context and baggage") {
+    ZipkinOtTracerOptions no_sampling;
+    no_sampling.sample_rate = 0.0;
+    auto r = new InMemoryReporter();
+    auto t = makeZipkinOtTracer(no_sampling, std::unique_ptr<Reporter>(r));
+
+    auto span_a = t->StartSpan("a");
+    CHECK(span_a);
+    span_a->SetTag("abc", 123);
+    span_a->SetBaggageItem("a", "1");
+    auto span_b = t->StartSpan("b", {ChildOf(&span_a->context())});
+    CHECK(span_b);
+    CHECK(span_b->BaggageItem("a") == "1");
+    TextMapCarrier carrier;
+    CHECK(t->Inject(span_b->context(), carrier));
+    CHECK(carrier.text_map["x-b3-sampled"] == "0");
+    span_b->Finish();
+    span_a->Finish();
+
+    CHECK(r->spans().empty());
+  }
+
   SECTION("You can set a single child-of reference when starting a span.") {
     auto span_a = tracer->StartSpan("a");
     CHECK(span_a);
@@ -0,0 +1,140 @@
+#include "../src/sampling.h"
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <zipkin/catch/catch.hpp>
+using namespace zipkin;
+
+static int countSampled(Sampler &sampler, int num_traces,
+                        opentracing::string_view operation_name = "a") {
+  std::mt19937_64 random_engine{1};
+  int num_sampled = 0;
+  for (int i = 0; i < num_traces; ++i) {
+    TraceId trace_id{random_engine()};
+    num_sampled += sampler.ShouldSample(operation_name, trace_id) ? 1 : 0;
+  }
+  return num_sampled;
+}
+
+TEST_CASE("ProbabilisticSampler") {
+  SECTION("The given fraction of traces is sampled") {
+    ProbabilisticSampler sampler{0.25};
+    auto num_sampled = countSampled(sampler, 10000);
+    CHECK(num_sampled > 2300);
+    CHECK(num_sampled < 2700);
+  }
+
+  SECTION("The decision only depends on the trace ID and the rate") {
+    ProbabilisticSampler sampler{0.5};
+    ProbabilisticSampler other_sampler{0.5};
+    ProbabilisticSampler lower_rate_sampler{0.1};
+    std::mt19937_64 random_engine{2};
+    for (int i = 0; i < 1000; ++i) {
+      TraceId trace_id{random_engine(), random_engine()};
+      auto is_sampled = sampler.ShouldSample("a", trace_id);
+      CHECK(other_sampler.ShouldSample("b", trace_id) == is_sampled);
+      if (lower_rate_sampler.ShouldSample("a", trace_id)) {
+        CHECK(is_sampled);
+      }
+    }
+  }
+
+  SECTION("Rates of zero and one sample nothing and everything") {
+    ProbabilisticSampler never_sampler{0.0};
+    ProbabilisticSampler always_sampler{1.0};
+    TraceId largest_trace_id{std::numeric_limits<uint64_t>::max()};
+    CHECK(always_sampler.ShouldSample("a", largest_trace_id));
+    CHECK(!never_sampler.ShouldSample("a", TraceId{1}));
+    CHECK(countSampled(always_sampler, 100) == 100);
+    CHECK(countSampled(never_sampler, 100) == 0);
+  }
+}
+
+TEST_CASE("RateLimitingSampler") {
+  SECTION("A burst is sampled up to a second's worth of traces") {
+    RateLimitingSampler sampler{10.0};
+    CHECK(countSampled(sampler, 100) == 10);
+  }
+
+  SECTION("Traces are sampled again as the bucket refills") {
+    RateLimitingSampler sampler{10.0};
+    countSampled(sampler, 100);
+    std::this_thread::sleep_for(std::chrono::milliseconds{250});
+    auto num_sampled = countSampled(sampler, 100);
+    CHECK(num_sampled >= 2);
+    CHECK(num_sampled <= 10);
+  }
+
+  SECTION("Less than one trace per second still allows one trace") {
+    RateLimitingSampler sampler{0.5};
+    CHECK(countSampled(sampler, 10) == 1);
+  }
+
+  SECTION("A rate of zero samples nothing") {
+    RateLimitingSampler sampler{0.0};
+    CHECK(countSampled(sampler, 10) == 0);
+  }
+
+  SECTION("The budget is shared by concurrent threads") {
+    RateLimitingSampler sampler{1000.0};
+    std::atomic<int> num_sampled{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back(
+          [&] { num_sampled += countSampled(sampler, 1000); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    // A second's worth, plus what was earned while the threads ran.
+    CHECK(num_sampled >= 1000);
+    CHECK(num_sampled < 1500);
+  }
+}
+
+TEST_CASE("PerOperationSampler") {
+  SECTION("Each operation is guaranteed a minimum number of traces") {
+    PerOperationSampler sampler{0.0, 10.0, {}, 100};
+    CHECK(countSampled(sampler, 100, "a") == 10);
+    CHECK(countSampled(sampler, 100, "b") == 10);
+  }
+
+  SECTION("Operations can have a rate of their own") {
+    PerOperationSampler sampler{0.0, 0.0, {{"important", 1.0}}, 100};
+    CHECK(countSampled(sampler, 100, "important") == 100);
+    CHECK(countSampled(sampler, 100, "health") == 0);
+  }
+
+  SECTION("Operations beyond the maximum are sampled at the default rate") {
+    PerOperationSampler sampler{0.0, 10.0, {}, 1};
+    CHECK(countSampled(sampler, 100, "a") == 10);
+    CHECK(countSampled(sampler, 100, "b") == 0);
+  }
+
+  SECTION("Configured operations keep their rate beyond the maximum") {
+    PerOperationSampler sampler{0.0, 0.0, {{"important", 1.0}}, 1};
+    CHECK(countSampled(sampler, 100, "a") == 0);
+    CHECK(countSampled(sampler, 100, "b") == 0);
+    CHECK(countSampled(sampler, 100, "important") == 100);
+  }
+
+  SECTION("An operation first seen by several threads is added once") {
+    PerOperationSampler sampler{0.0, 10.0, {}, 100};
+    std::atomic<int> num_sampled{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back(
+          [&] { num_sampled += countSampled(sampler, 100, "a"); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    CHECK(num_sampled == 10);
+  }
+}